@@ -0,0 +1,342 @@
+#pragma once
+/**
+ * The drift detectors monitor a stream of errors (e.g., 0 for a correct prediction, 1 for a mistake) and tell when its distribution changes.
+ * A drift detector provides:
+ * - detects_drift: false if the detector never detects anything, so the learners can skip the monitoring entirely.
+ * - update(error): add an error to the stream and return true if a drift has been detected. After a drift, the detector forgets the errors from before the drift.
+ * - reset(): forget the errors seen so far.
+ * All detectors take the same *func* template parameter, a class type with the mathematical functions they need.
+ */
+
+/**
+ * Detector that never detects a drift. It is used to disable the drift detection.
+ * Templates:
+ * - func: a class type that contains all needed function for the detector (none).
+ */
+template<class func>
+class NoDriftDetection{
+	public:
+	static bool const detects_drift = false;
+	bool update(double const){
+		return false;
+	}
+	void reset(void){
+	}
+};
+
+/**
+ * Implement the Page-Hinkley test.
+ * The test accumulates the deviations of the errors from their mean, minus a tolerance, and detects a drift when the accumulation
+ * goes above its minimum by more than a threshold.
+ * Templates:
+ * - func: a class type that contains all needed function for the detector (none).
+ */
+template<class func>
+class PageHinkley{
+	double tolerance; //The magnitude of the changes that are tolerated (delta)
+	double threshold; //The detection threshold (lambda)
+	int min_count; //The number of errors to see before detecting anything
+	int count = 0;
+	double mean = 0, sum = 0, minimum = 0;
+	public:
+	static bool const detects_drift = true;
+	/**
+	 * The constructor of the Page-Hinkley test.
+	 * @param tolerance The magnitude of the changes that are tolerated.
+	 * @param threshold The detection threshold. A higher threshold gives less false alarms but detects the drifts later.
+	 * @param min_count The number of errors to see before detecting anything.
+	 */
+	PageHinkley(double const tolerance = 0.005, double const threshold = 50, int const min_count = 30){
+		this->tolerance = tolerance;
+		this->threshold = threshold;
+		this->min_count = min_count;
+	}
+	/**
+	 * Add an error and return true if a drift has been detected.
+	 * @param error The error.
+	 */
+	bool update(double const error){
+		count += 1;
+		mean += (error - mean) / count;
+		sum += error - mean - tolerance;
+		minimum = (sum < minimum ? sum : minimum);
+		if(count >= min_count && sum - minimum > threshold){
+			reset();
+			return true;
+		}
+		return false;
+	}
+	/**
+	 * Forget the errors seen so far.
+	 */
+	void reset(void){
+		count = 0;
+		mean = 0;
+		sum = 0;
+		minimum = 0;
+	}
+};
+
+/**
+ * Implement the Drift Detection Method (DDM) of Gama et al.
+ * DDM follows the error rate p and its standard deviation s = sqrt(p(1-p)/n), and remembers their values when p+s was minimal.
+ * A warning is raised when p+s goes above the minimum by *warning_level* standard deviations, and a drift by *drift_level* standard deviations.
+ * Templates:
+ * - func: a class type that contains all needed function for the detector.
+ *   	+ sqrt function: a square root function.
+ */
+template<class func>
+class DDM{
+	double warning_level, drift_level;
+	int min_count; //The number of errors to see before detecting anything
+	int count = 0;
+	double error_rate = 0;
+	//The error rate and its standard deviation when their sum was minimal
+	double min_error_rate = 0, min_stdev = 0;
+	bool warning = false;
+	public:
+	static bool const detects_drift = true;
+	/**
+	 * The constructor of DDM.
+	 * @param warning_level The number of standard deviations above the minimum that raises a warning.
+	 * @param drift_level The number of standard deviations above the minimum that signals a drift.
+	 * @param min_count The number of errors to see before detecting anything.
+	 */
+	DDM(double const warning_level = 2, double const drift_level = 3, int const min_count = 30){
+		this->warning_level = warning_level;
+		this->drift_level = drift_level;
+		this->min_count = min_count;
+	}
+	/**
+	 * Add an error and return true if a drift has been detected.
+	 * @param error The error, either 0 or 1.
+	 */
+	bool update(double const error){
+		count += 1;
+		error_rate += (error - error_rate) / count;
+		double const stdev = func::sqrt(error_rate * (1 - error_rate) / count);
+		warning = false;
+		if(count < min_count)
+			return false;
+		if(min_count == count || error_rate + stdev <= min_error_rate + min_stdev){
+			min_error_rate = error_rate;
+			min_stdev = stdev;
+		}
+		if(error_rate + stdev > min_error_rate + drift_level * min_stdev){
+			reset();
+			return true;
+		}
+		warning = (error_rate + stdev > min_error_rate + warning_level * min_stdev);
+		return false;
+	}
+	/**
+	 * Return true if the last error raised a warning, meaning a drift may be coming.
+	 */
+	bool is_warning(void) const{
+		return warning;
+	}
+	/**
+	 * Forget the errors seen so far.
+	 */
+	void reset(void){
+		count = 0;
+		error_rate = 0;
+		min_error_rate = 0;
+		min_stdev = 0;
+		warning = false;
+	}
+};
+
+/**
+ * Implement the ADaptive WINdowing algorithm (ADWIN) of Bifet and Gavalda.
+ * ADWIN keeps a window of the recent errors and drops its oldest part whenever the means of the two parts are significantly different.
+ * The window is compressed in an exponential histogram: the buckets of level *i* summarize 2^i errors, and each level keeps at most *max_buckets* buckets.
+ * The buckets are stored in fixed arrays, so the memory does not depend on the window size, and the update costs O(log W) amortized for a window of size W.
+ * The cuts between the buckets are only checked every *clock* errors.
+ * Templates:
+ * - func: a class type that contains all needed function for the detector.
+ *   	+ log function: the natural logarithm.
+ *   	+ sqrt function: a square root function.
+ * - max_buckets: the number of buckets per level (M). More buckets give more precise cuts.
+ * - max_levels: the number of levels (at most 30). When the last level is full, its oldest bucket is dropped, so the window holds at most max_buckets*(2^max_levels-1) errors.
+ */
+template<class func, int max_buckets = 5, int max_levels = 20>
+class ADWIN{
+	double delta; //The confidence of the cuts
+	int clock; //The number of errors between two checks of the cuts
+	int min_length; //The minimum number of errors on each side of a cut
+	//The buckets of each level, from the oldest to the newest. A level may hold one more bucket until it is compressed.
+	double totals[max_levels][max_buckets+1];
+	double variances[max_levels][max_buckets+1];
+	int bucket_count[max_levels];
+	int level_count = 0;
+	//The size of the window, the sum of the errors and their variance times the width
+	int width = 0;
+	double total = 0, variance = 0;
+	int time = 0;
+	public:
+	static bool const detects_drift = true;
+	/**
+	 * The constructor of ADWIN.
+	 * @param delta The confidence of the cuts. A lower value gives less false alarms but detects the drifts later.
+	 * @param clock The number of errors between two checks of the cuts.
+	 * @param min_length The minimum number of errors on each side of a cut.
+	 */
+	ADWIN(double const delta = 0.002, int const clock = 32, int const min_length = 5){
+		this->delta = delta;
+		this->clock = clock;
+		this->min_length = min_length;
+		for(int i = 0; i < max_levels; ++i)
+			bucket_count[i] = 0;
+	}
+	/**
+	 * Add an error and return true if a drift has been detected, in which case the oldest part of the window has been dropped.
+	 * @param error The error.
+	 */
+	bool update(double const error){
+		//Update the statistics of the window incrementally
+		width += 1;
+		if(width > 1){
+			double const diff = error - total / (width - 1);
+			variance += (width - 1) * diff * diff / width;
+		}
+		total += error;
+		insert_bucket(0, error, 0);
+		compress();
+
+		time += 1;
+		if(time % clock != 0 || width <= min_length)
+			return false;
+		bool drift = false;
+		while(cut()){
+			drift = true;
+		}
+		return drift;
+	}
+	/**
+	 * Return the number of errors in the window.
+	 */
+	int get_width(void) const{
+		return width;
+	}
+	/**
+	 * Return the mean of the errors in the window.
+	 */
+	double get_mean(void) const{
+		return (width > 0 ? total / width : 0);
+	}
+	/**
+	 * Return the variance of the errors in the window.
+	 */
+	double get_variance(void) const{
+		return (width > 0 ? variance / width : 0);
+	}
+	/**
+	 * Forget the errors seen so far.
+	 */
+	void reset(void){
+		for(int i = 0; i < level_count; ++i)
+			bucket_count[i] = 0;
+		level_count = 0;
+		width = 0;
+		total = 0;
+		variance = 0;
+		time = 0;
+	}
+	private:
+	/**
+	 * Add a bucket after the newest bucket of a level.
+	 * @param level The level.
+	 * @param bucket_total The sum of the errors of the bucket.
+	 * @param bucket_variance The variance of the errors of the bucket times their number.
+	 */
+	void insert_bucket(int const level, double const bucket_total, double const bucket_variance){
+		if(level == level_count)
+			level_count += 1;
+		int const i = bucket_count[level];
+		totals[level][i] = bucket_total;
+		variances[level][i] = bucket_variance;
+		bucket_count[level] += 1;
+	}
+	/**
+	 * Remove the *count* oldest buckets of a level.
+	 * @param level The level.
+	 * @param count The number of buckets to remove.
+	 */
+	void remove_buckets(int const level, int const count){
+		bucket_count[level] -= count;
+		for(int i = 0; i < bucket_count[level]; ++i){
+			totals[level][i] = totals[level][i + count];
+			variances[level][i] = variances[level][i + count];
+		}
+		while(level_count > 0 && bucket_count[level_count - 1] == 0)
+			level_count -= 1;
+	}
+	/**
+	 * Merge the two oldest buckets of every level that holds too many buckets into a bucket of the next level.
+	 * When the last level is full, its oldest bucket is dropped from the window instead.
+	 */
+	void compress(void){
+		for(int level = 0; level < level_count && bucket_count[level] > max_buckets; ++level){
+			if(level == max_levels - 1){
+				drop_oldest();
+				return;
+			}
+			double const size = static_cast<double>(1 << level);
+			double const diff = totals[level][0] / size - totals[level][1] / size;
+			double const merged_variance = variances[level][0] + variances[level][1] + size * diff * diff / 2;
+			insert_bucket(level + 1, totals[level][0] + totals[level][1], merged_variance);
+			remove_buckets(level, 2);
+		}
+	}
+	/**
+	 * Remove the oldest bucket of the window.
+	 */
+	void drop_oldest(void){
+		int const level = level_count - 1;
+		double const size = static_cast<double>(1 << level);
+		double const bucket_total = totals[level][0];
+		width -= (1 << level);
+		total -= bucket_total;
+		if(width > 0){
+			double const diff = bucket_total / size - total / width;
+			variance -= variances[level][0] + size * width * diff * diff / (size + width);
+		}
+		else{
+			variance = 0;
+		}
+		remove_buckets(level, 1);
+	}
+	/**
+	 * Look for a cut between two buckets where the means of the older and the newer parts of the window are significantly different.
+	 * If there is one, the oldest bucket is dropped and the function returns true.
+	 */
+	bool cut(void){
+		//Part 0 is the older part of the window, part 1 the newer one
+		double n0 = 0, n1 = width, u0 = 0, u1 = total;
+		double const log_term = func::log(2 * func::log(static_cast<double>(width)) / delta);
+		double const window_variance = variance / width;
+		for(int level = level_count - 1; level >= 0; --level){
+			double const size = static_cast<double>(1 << level);
+			for(int i = 0; i < bucket_count[level]; ++i){
+				n0 += size;
+				n1 -= size;
+				u0 += totals[level][i];
+				u1 -= totals[level][i];
+				//The newest bucket cannot be cut from the rest
+				if(level == 0 && i == bucket_count[level] - 1)
+					return false;
+				if(n0 < min_length || n1 < min_length)
+					continue;
+				double const diff = u0 / n0 - u1 / n1;
+				double const m = 1 / (n0 - min_length + 1) + 1 / (n1 - min_length + 1);
+				double const epsilon = func::sqrt(2 * m * window_variance * log_term) + 2.0 / 3.0 * log_term * m;
+				if(diff > epsilon || -diff > epsilon){
+					drop_oldest();
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <cmath>
+/**
+ * GaussianEstimator incrementally estimates the normal distribution of a numeric value using Welford's algorithm.
+ * A GaussianEstimator filled with zeros is empty, so it can be stored in a zeroed buffer.
+ * Templates:
+ * - func: a class type that contains all needed function for the estimator.
+ *   	+ sqrt function: a square root function.
+ */
+template<class func>
+class GaussianEstimator{
+	double weight_sum = 0, variance_sum = 0, mean = 0;
+	public:
+	/**
+	 * Add a value to the estimator.
+	 * @param value The value.
+	 * @param weight The weight of the value.
+	 */
+	void train(double const value, double const weight){
+		if (weight_sum > 0.0) {
+			weight_sum += weight;
+			double const previous_mean = mean;
+			mean += weight * (value - previous_mean) / weight_sum;
+			variance_sum += weight * (value - previous_mean) * (value - mean);
+		}
+		else {
+			mean = value;
+			weight_sum = weight;
+			variance_sum = 0;
+		}
+	}
+	/**
+	 * Add the values of another estimator to this estimator, as if they had been added to this one.
+	 * The means and the variances are combined with the parallel algorithm of Chan et al.
+	 * @param other The other estimator.
+	 */
+	void merge(GaussianEstimator const& other){
+		if(other.weight_sum <= 0)
+			return;
+		if(weight_sum <= 0){
+			*this = other;
+			return;
+		}
+		double const total = weight_sum + other.weight_sum;
+		double const diff = other.mean - mean;
+		mean += diff * other.weight_sum / total;
+		variance_sum += other.variance_sum + diff * diff * weight_sum * other.weight_sum / total;
+		weight_sum = total;
+	}
+	/**
+	 * Return the sum of the weights of the values added to the estimator.
+	 */
+	double get_weight(void) const{
+		return weight_sum;
+	}
+	/**
+	 * Return the mean of the values added to the estimator.
+	 */
+	double get_mean(void) const{
+		return mean;
+	}
+	/**
+	 * Return the variance of the values added to the estimator.
+	 */
+	double get_variance(void) const{
+		return (weight_sum > 1.0) ? (variance_sum / (weight_sum - 1.0)) : 0.0;
+	}
+	/**
+	 * Return the standard deviation of the values added to the estimator.
+	 */
+	double get_stdev(void) const{
+		return func::sqrt(get_variance());
+	}
+	/**
+	 * Return the probability density of the estimated normal distribution at *value*.
+	 * @param value The value.
+	 */
+	double probability_density(double const value) const{
+		if(weight_sum <= 0)
+			return 0.0;
+		double const stdev = get_stdev();
+		if(stdev > 0){
+			double const diff = value - mean;
+			double const NORMAL_CONSTANT = 2.50663; //square root of 2*M_PI
+			return (1.0 / (NORMAL_CONSTANT * stdev)) * exp(-(diff * diff / (2.0 * stdev * stdev)));
+		}
+		return (value == mean) ? 1.0 : 0.0;
+	}
+	/**
+	 * Return the weight of the values estimated to be lower or equal to *value*.
+	 * @param value The value.
+	 */
+	double weight_below(double const value) const{
+		if(weight_sum <= 0)
+			return 0.0;
+		double const stdev = get_stdev();
+		if(stdev > 0){
+			double const SQRT_2 = 1.41421356237;
+			return weight_sum * 0.5 * (1 + erf((value - mean) / (stdev * SQRT_2)));
+		}
+		return (value >= mean) ? weight_sum : 0.0;
+	}
+	private:
+	/**
+	 * Approximate the error function with the Abramowitz and Stegun formula 7.1.26 (maximum error: 1.5e-7).
+	 * @param x The value.
+	 */
+	static double erf(double const x){
+		double const t = 1.0 / (1.0 + 0.3275911 * (x < 0 ? -x : x));
+		double const polynomial = t * (0.254829592 + t * (-0.284496736 + t * (1.421413741 + t * (-1.453152027 + t * 1.061405429))));
+		double const y = 1.0 - polynomial * exp(-x * x);
+		return (x < 0 ? -y : y);
+	}
+};
@@ -1,32 +1,217 @@
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include "gaussian_estimator.hpp"
+#include "drift_detection.hpp"
+/**
+ * The numeric attribute observers keep, in each leaf, the statistics of one feature needed to evaluate the splits on that feature.
+ * An observer provides:
+ * - dynamic_limits: true if the statistics do not depend on the limits. The leaves then do not store any limit:
+ *   the candidate limits are computed from the box of the leaf when the splits are evaluated, and *limits* is null in *train*.
+ * - size(bin_count): the number of bytes needed by the statistics of a feature with *bin_count* bins (so *bin_count-1* limits).
+ * - train(statistics, bin_count, limits, value, label): add a value to the statistics.
+ * - add_left_counts(statistics, bin_count, cut, limit, left_counts): called for each cut in increasing order with the same *left_counts* (initially zeros),
+ *   it updates *left_counts* so that it contains, for each label, the number of data points lower or equal than *limit*, the limit of the cut *cut*.
+ * The statistics are stored in a zeroed buffer, so zeros must be a valid empty state.
+ */
+
+/**
+ * Observer that counts the data points per bin and per label. The statistics are stored as [bin][label].
+ * Templates:
+ * - label_count: the number of label.
+ */
+template<int label_count>
+class HoeffdingBinObserver{
+	public:
+	static bool const dynamic_limits = false;
+	static int size(int const bin_count){
+		return bin_count * label_count * sizeof(int);
+	}
+	static void train(char* statistics, int const bin_count, double const* limits, double const value, int const label){
+		int* counters = reinterpret_cast<int*>(statistics);
+		counters[find_bin(limits, bin_count-1, value) * label_count + label] += 1;
+	}
+	static void add_left_counts(char const* statistics, int const, int const cut, double const, double* left_counts){
+		//The bin *cut* is the last bin on the left of the limit *cut*
+		int const* counters = reinterpret_cast<int const*>(statistics) + cut * label_count;
+		for(int l = 0; l < label_count; ++l)
+			left_counts[l] += counters[l];
+	}
+	/**
+	 * Find the bin of a value using a branchless binary search over the sorted limits of a feature.
+	 * The bin is the number of limits lower or equal to the value, so values above the last limit fall in the last bin.
+	 * @param limits The limits of the feature.
+	 * @param limit_count The number of limits of the feature.
+	 * @param value The value of the feature.
+	 */
+	static int find_bin(double const* limits, int limit_count, double const value){
+		int bin = 0;
+		while(limit_count > 0){
+			int const half = limit_count / 2;
+			bool const go_right = (limits[bin + half] <= value);
+			bin = go_right ? (bin + half + 1) : bin;
+			limit_count = go_right ? (limit_count - half - 1) : half;
+		}
+		return bin;
+	}
+};
+/**
+ * Observer that estimates a normal distribution per label. The statistics are stored as [label].
+ * The memory does not depend on the number of bins, which only sets the number of candidate limits, and the leaves store neither the limits nor their information gains.
+ * Templates:
+ * - label_count: the number of label.
+ * - func: a class type that contains the functions needed by GaussianEstimator.
+ */
+template<int label_count, class func>
+class HoeffdingGaussianObserver{
+	public:
+	static bool const dynamic_limits = true;
+	static int size(int const){
+		return label_count * sizeof(GaussianEstimator<func>);
+	}
+	static void train(char* statistics, int const, double const*, double const value, int const label){
+		reinterpret_cast<GaussianEstimator<func>*>(statistics)[label].train(value, 1.0);
+	}
+	static void add_left_counts(char const* statistics, int const, int const, double const limit, double* left_counts){
+		GaussianEstimator<func> const* estimators = reinterpret_cast<GaussianEstimator<func> const*>(statistics);
+		for(int l = 0; l < label_count; ++l)
+			left_counts[l] = estimators[l].weight_below(limit);
+	}
+};
+
 /**
  * Implement the Hoeffding Tree algorithm.
  * - feature_type: the type of the feature (int, double, float, short, ...).
  * - feature_count: the number of feature per data point.
  * - label_count: the number of label.
- * - max_size: the maximum value the data point can reach.
+ * - max_size: the size of the memory of the tree, in bytes: the nodes, their routing nodes and the counters of the leaves.
  * - func: a class type that contains all needed function for the Hoeffding Tree.
  *   	+ log function: A function that run the natural logarithm.
  *   	+ log2 function: A function that run the base two logarithm.
  *   	+ isnan function: A function that run true if the first parameter is Not a Number.
+ *   	+ sqrt function: A function that run the square root (only for HoeffdingGaussianObserver).
+ * - observer: the numeric attribute observer that keeps the statistics of each feature in the leaves (default: HoeffdingBinObserver).
+ * - drift_detector: the drift detector that monitors the errors of each internal node (default: NoDriftDetection).
+ *   With a detector, the tree is a Hoeffding Adaptive Tree: when a drift is detected in an internal node, an alternate subtree is grown
+ *   from that node with the new data points, and it replaces the subtree of the node once its error is significantly lower.
  */
 
-template<class feature_type, int feature_count, int label_count, int max_size, class func>
+template<class feature_type, int feature_count, int label_count, int max_size, class func, class observer = HoeffdingBinObserver<label_count>, class drift_detector = NoDriftDetection<func>>
 class HoeffdingTree{
 	static int const EMPTY_NODE = -1;
-	//The buffer that will store all the node and the counters
-	char buffer[max_size] = {0};
+	//The number of data points seen by an alternate subtree before it is compared to the subtree of its node
+	static int const ALTERNATE_MIN_COUNT = 300;
+	//The probability of error when comparing an alternate subtree to the subtree of its node
+	static constexpr double ALTERNATE_DELTA = 0.05;
 	//Offsets from the beginning and the end of the buffer
-	int buffer_offset = 0, buffer_preset = max_size;
+	int buffer_offset = 0, buffer_preset = BUFFER_SIZE;
 	double delta; //Probability of error in the Hoeffding bound
+	int grace_period; //Number of data points a leaf receives between two evaluations of its splits (n_min)
+	double tie_threshold; //Below this Hoeffding bound, the two best splits are considered tied and the best one is used (tau)
+	double gain_range; //The range of the information gain in the Hoeffding bound (R)
 	//The number of values for each feature
 	int features_size[feature_count];
 	//The sum of the value in features_size
 	int sum_feature_size = 0;
+	//The index of the first bin of each feature, which is the sum of the sizes of the previous features
+	int features_offset[feature_count];
+	//The offset, in bytes, of the statistics of each feature in a leaf, and the size of the statistics of all features
+	int statistics_offset[feature_count];
+	int statistics_size = 0;
+	//The number of calls to *train* between two reorganizations of the active and inactive leaves (0 to disable them)
+	int memory_period;
+	int train_count = 0;
+	//The number of leaves deactivated to save memory
+	int inactive_count = 0;
+	//The nodes freed when a subtree is discarded, linked through their left child: pairs of siblings and single nodes (alternate roots)
+	int free_pairs = EMPTY_NODE, free_singles = EMPTY_NODE;
+	//The drift detector copied in every new node
+	drift_detector detector_prototype;
+
+	/*
+	 * The routing nodes hold what the inference needs, in 16 bytes per node, separately from the training data of the nodes.
+	 * The routing node *i* describes the node *i* of *buffer*. Their memory is taken from *max_size*, see NODE_CAPACITY.
+	 * - For an internal node, *child* is the index of the left child, the right child being at *child+1*.
+	 * - For a leaf, *split_feature* is -1 and *child* is the majority label of the leaf.
+	 */
+	struct RoutingNode{
+		double split_value;
+		int split_feature;
+		int child;
+	};
+	static_assert(sizeof(RoutingNode) == 16, "A routing node must fit in 16 bytes.");
+	//The number of data points routed together by *predict_batch*
+	static int const BATCH_BLOCK_SIZE = 64;
+
+	/*
+	 * The data a node needs to adapt to the drifts. It is only part of the nodes when the drift detector detects drifts,
+	 * so the nodes of a tree that does not adapt keep their size.
+	 */
+	template<bool detects_drift, class dummy = void>
+	struct Adaptation{
+		//The drift detector of the node, only used by the internal nodes
+		drift_detector detector;
+		//The root of the alternate subtree of the node, if any
+		int alternate;
+		//The number of data points seen since the alternate subtree was created, and how many of them were misclassified by the node and by its alternate
+		int compare_count, errors, alternate_errors;
+		/**
+		 * Return the root of the alternate subtree, or EMPTY_NODE.
+		 */
+		int get_alternate(void) const{
+			return alternate;
+		}
+		/**
+		 * Forget the alternate subtree, which must have been freed.
+		 */
+		void forget_alternate(void){
+			alternate = EMPTY_NODE;
+		}
+		/**
+		 * Set the drift detector, which forgets the errors seen so far.
+		 * @param prototype The drift detector to copy.
+		 */
+		void set_detector(drift_detector const& prototype){
+			detector = prototype;
+		}
+		/**
+		 * Reset the drift detector and forget the alternate subtree, which must have been freed.
+		 * @param prototype The drift detector to copy.
+		 */
+		void reset_drift(drift_detector const& prototype){
+			detector = prototype;
+			alternate = EMPTY_NODE;
+			compare_count = 0;
+			errors = 0;
+			alternate_errors = 0;
+		}
+	};
+	/*
+	 * Without drift detection, the nodes have no alternate subtree and nothing to store.
+	 */
+	template<class dummy>
+	struct Adaptation<false, dummy>{
+		int get_alternate(void) const{
+			return EMPTY_NODE;
+		}
+		void forget_alternate(void){
+		}
+		void set_detector(drift_detector const&){
+		}
+		void reset_drift(drift_detector const&){
+		}
+	};
 
 	public:
-	class Node{
+	class Node : public Adaptation<drift_detector::detects_drift>{
 		//Declare HoeffdingTree friend to its own nodes because Node may be exposed throught a public interface.
 		friend class HoeffdingTree;
+		//The size of the integers stored at the beginning of the counters: the count of data points, the count at the last evaluation of the splits, the index of the node that owns the counters and the count per label.
+		static int const HEADER_SIZE = (3 + label_count) * sizeof(int);
+		//The value of *split_feature* for a leaf that has been deactivated to save memory. Such leaf has no counters.
+		static int const INACTIVE_LEAF = std::numeric_limits<int>::min();
+		//The value of *split_feature* for a node that has been freed and can be reused.
+		static int const FREE_NODE = std::numeric_limits<int>::min() + 1;
 		//A pointer to the tree the node belongs
 		HoeffdingTree* tree;
 		//The spliting feature if it is an internal node, otherwise, it is the location of the counters in buffer
@@ -38,6 +223,8 @@ class HoeffdingTree{
 		double u_box[feature_count];
 		//The children of the node if it is an internal node
 		int children[2]; //children[0] == left, children[1] == right
+		//The number of data points per label seen by the node since its creation. Unlike the counters, they are kept when the leaf is deactivated.
+		int seen_per_label[label_count];
 		public:
 		/**
 		 * The constructor of the node.
@@ -45,23 +232,20 @@ class HoeffdingTree{
 		 */
 		Node(HoeffdingTree& t){
 			this->tree = &t;
-			// find the index for the counters :>
 			// NOTE: in the new operator, we made sure that there was space for the node and its counters.
-			int const total_size_counters = compute_total_size_counters(tree->sum_feature_size);
-			int const tmp_preset = tree->buffer_preset - total_size_counters;
-			this->split_feature = - ((max_size - tmp_preset) / total_size_counters); //we need negative number because counters are store on the other side of buffer
-			reset_counters();
-			double const infinity = std::numeric_limits<float>::infinity();
+			allocate_counters();
+			init_routing();
+			for(int l = 0; l < label_count; ++l)
+				seen_per_label[l] = 0;
+			//The box starts empty and grows with the data points
+			double const infinity = std::numeric_limits<double>::infinity();
 			for(int i = 0; i < feature_count; ++i){
-				l_box[i] = -infinity;
-				u_box[i] =  infinity;
+				l_box[i] =  infinity;
+				u_box[i] = -infinity;
 			}
-			int* count;
-			double* limits;
-			double* info_sum;
-			get_informations(count, limits, info_sum);
 			children[0] = EMPTY_NODE;
 			children[1] = EMPTY_NODE;
+			reset_adaptation();
 		}
 		/**
 		 * The constructor of the node using another node.
@@ -72,39 +256,53 @@ class HoeffdingTree{
 			this->split_feature = parent.split_feature;	
 			this->tree = parent.tree;
 			reset_counters();
+			set_owner();
+			init_routing();
+			for(int l = 0; l < label_count; ++l)
+				seen_per_label[l] = 0;
 			for(int i = 0; i < feature_count; ++i){
 				l_box[i] = parent.l_box[i];
 				u_box[i] = parent.u_box[i];
 			}
 			children[0] = EMPTY_NODE;
 			children[1] = EMPTY_NODE;
+			reset_adaptation();
 		}
 		/**
 		 * Return true if the node is a leaf.
 		 */
 		bool is_leaf(void) const{
-			return (split_feature < 0);
+			return (split_feature < 0 && split_feature != FREE_NODE);
+		}
+		/**
+		 * Return true if the node is a leaf that has been deactivated to save memory.
+		 * An inactive leaf still predicts but does not look for splits.
+		 */
+		bool is_inactive(void) const{
+			return (split_feature == INACTIVE_LEAF);
 		}
 		/**
-		 * Predict the class of the data point *features*.
-		 * @param features The value of the data point.
+		 * Return the promise of the leaf, which is the number of data points it would have misclassified.
+		 * The leaves with the lowest promise are deactivated first when memory is needed.
+		 */
+		int promise(void) const{
+			int sum = 0, best = 0;
+			for(int l = 0; l < label_count; ++l){
+				sum += seen_per_label[l];
+				best = (seen_per_label[l] > best ? seen_per_label[l] : best);
+			}
+			return sum - best;
+		}
+		/**
+		 * Predict the class of a data point that reached this leaf. The leaf predicts its majority label, so the features of the data point are not used.
 		 * @param probabilities The output array that will contains the score for each label.
 		 */
-		int predict(feature_type const* features, double* probabilities) const{
-			int* count;
-			double* limits;
-			double* info_sum;
-			int* counters[label_count];
-			for(int i = 0; i < label_count; ++i)
-				counters[i] = get_counters(i);
-			get_informations(count, limits, info_sum);
-
+		int predict(feature_type const*, double* probabilities) const{
 			//Computing the majority vote
 			double counts[label_count] = {0};
 			double sum = 0;
-			for(int l = 0; l < label_count; ++l){ //we want the number of occurence per label
-				for(int i = 0; i < tree->features_size[0]; ++i) //this number of occurence is the sum of occurence for all value of the first feature ... or the second ...
-					counts[l] += counters[l][i];
+			for(int l = 0; l < label_count; ++l){
+				counts[l] = seen_per_label[l];
 				sum += counts[l];
 			}
 			int best = 0;
@@ -124,11 +322,13 @@ class HoeffdingTree{
 		 * @param value The value to use for the split.
 		 */
 		int split(int const feature, double const value){
-			Node* child_right = new (*tree) Node(*tree);
-			//NOTE: child_left has been created re-using counters and bounds from current node
-			Node* child_left = new (*tree) Node(*this); 
-			if(child_left == nullptr || child_right == nullptr) // No more node available
+			if(!tree->has_space_for_split()) // No more node available
 				return -1;
+			//NOTE: child_left has been created re-using counters and bounds from current node
+			//The left child is allocated first so the right child is always right after it, which the routing nodes rely on
+			Node* children_nodes = tree->allocate_pair();
+			Node* child_left = new (children_nodes) Node(*this); 
+			Node* child_right = new (children_nodes + 1) Node(*tree);
 			//This operation return the index of child_left since the cell size of the pointer is sizeof Node
 			children[0] = child_left - reinterpret_cast<Node*>(tree->buffer); 
 			children[1] = child_right - reinterpret_cast<Node*>(tree->buffer);
@@ -136,6 +336,10 @@ class HoeffdingTree{
 			//Set the value of split for this node. From here we don't have access to the previous counters.
 			split_feature = feature;
 			split_value = value;
+			RoutingNode& routing = tree->routing[index()];
+			routing.split_value = split_value;
+			routing.split_feature = split_feature;
+			routing.child = children[0];
 
 			//NOTE: *child_left* has been use the box of its parent already
 			//Just set the box for *child_right*
@@ -154,92 +358,87 @@ class HoeffdingTree{
 		}
 		/**
 		 * Train the tree with a data point.
+		 * The splits are only evaluated once every *grace_period* data points, the rest of the time, only the counters are updated.
 		 * @param features The data point.
 		 * @param label The label of the data point.
 		 * @param An output value. Will contain the value suggested for the split if the return value is not negative.
 		 */
 		int train(feature_type const* features, int const label, double& split_value){
+			seen_per_label[label] += 1;
+			//Keep the majority label of the routing node up to date
+			int& majority = tree->routing[index()].child;
+			if(seen_per_label[label] > seen_per_label[majority] || (seen_per_label[label] == seen_per_label[majority] && label < majority))
+				majority = label;
+			//Update the box
+			for(int f = 0; f < feature_count; ++f){
+				u_box[f] = u_box[f] < features[f] ? features[f] : u_box[f];
+				l_box[f] = l_box[f] > features[f] ? features[f] : l_box[f];
+			}
+			//An inactive leaf has no counters, so it only keeps track of the labels
+			if(is_inactive())
+				return -1;
+
 			int* count;
 			double* limits;
 			double* info_sum;
-			int* counters[label_count];
-			for(int i = 0; i < label_count; ++i)
-				counters[i] = get_counters(i);
+			char* statistics = get_statistics();
 			get_informations(count, limits, info_sum);
+			int* evaluated_count = count + 1;
 
-			//We increment the counters to train the node
-			int tmp_feature_sum = 0;
-			int* label_counters = counters[label];
-			
 			//There one more data point in this leaf
 			*count += 1;
-				 
-			//Update the box
-			for(int f = 0; f < feature_count; ++f){
-				u_box[f] = u_box[f] < features[f] ? features[f] : u_box[f];
-				l_box[f] = l_box[f] > features[f] ? features[f] : l_box[f];
-			}
+			get_label_counts()[label] += 1;
 
+			//We give the data point to the observers to train the node
 			for(int f = 0; f < feature_count; ++f){
-				bool limit_found = false;
-				//Look for the bin
-				for(int lim_index = 0; lim_index < (tree->features_size[f]-1); ++lim_index){ //There is one limit less than there  is bins
-					//NOTE the limits are supposed to be sorted
-					if(features[f] < limits[tmp_feature_sum+lim_index-f]){
-						label_counters[tmp_feature_sum + lim_index] += 1;
-						limit_found = true;
-						break;
-					}
-				}
-
-				if(!limit_found) //We didn't found the limit in the loop, then it is the last bin
-					label_counters[tmp_feature_sum +(tree->features_size[f]-1)] += 1;
-				tmp_feature_sum += tree->features_size[f];
-			}
-			//Now we need to update *info_sum*
-			double info_gain[tree->sum_feature_size-feature_count];			
-			//NOTE: no need to initialize output because it will be set.
-			compute_information_gain(static_cast<double>(*count), counters, info_gain);
-			double const d_count = static_cast<double>(*count);
-			for(int i = 0; i < (tree->sum_feature_size-feature_count); ++i){
-				info_sum[i] += info_gain[i];
-				info_gain[i] = info_sum[i] / d_count;
+				//There is one limit less than there is bins, and the limits of feature *f* start at *features_offset[f] - f*
+				double const* feature_limits = (observer::dynamic_limits ? nullptr : limits + tree->features_offset[f] - f);
+				observer::train(statistics + tree->statistics_offset[f], tree->features_size[f], feature_limits, features[f], label);
 			}
+			//Wait for the end of the grace period before looking at the splits
+			int const unevaluated_count = *count - *evaluated_count;
+			if(unevaluated_count < tree->grace_period)
+				return -1;
+			*evaluated_count = *count;
 
-			//Look for the two best split.
-			//*best_split* contains indexes.
-			int best_split[2] = {0, 1};
-			//The information gain of best_split[0] is always greater than best_split[1]
-			//So we may need to switch it
-			if(info_gain[best_split[0]] < info_gain[best_split[1]]){
-				best_split[0] = 1;
-				best_split[1] = 0;
-			}
-			//Browse indexes higher than 1 and keep the order of *best_split* when replacing an index
-			for(int i = 2; i < (tree->sum_feature_size-feature_count); ++i){
-				if(info_gain[i] > info_gain[best_split[0]]){
-					best_split[1] = best_split[0];
-					best_split[0] = i;
-				}
-				else if(info_gain[i] > info_gain[best_split[1]]){
-					best_split[1] = i;
+			//Look for the two best splits
+			double const d_count = static_cast<double>(*count);
+			int const cut_count = tree->sum_feature_size-feature_count;
+			BestCuts best;
+			if(observer::dynamic_limits){
+				//The statistics summarize all data points, so the limits follow the box and the information gains (times the count) are ranked as they are computed
+				double const entropy_leaf = compute_entropy(get_label_counts(), d_count);
+				for(int f = 0; f < feature_count; ++f){
+					RankGain output = {best, tree->features_offset[f] - f, d_count, entropy_leaf};
+					sweep_cut_entropies(f, statistics, output);
 				}
 			}
-			//compute Hoeffding bound
-			double const epsilon = 4 * func::log(1/tree->delta) / (2*d_count);
-			double const diff = (info_gain[best_split[0]] - info_gain[best_split[1]]);
-			double const square_diff = diff * diff;
-			if(square_diff > epsilon && info_gain[best_split[0]] > 0){
-				split_value = limits[best_split[0]];
-				//Try to retrieve the feature concerned :>
-				int tmp_c = tree->features_size[0];
-				for(int f = 0; f < feature_count-1; ++f){
-					if(best_split[0] < tmp_c)
-						return f;
-					tmp_c += tree->features_size[f+1];
-				}
-				//If the feature is not found, it must be the last one
-				return feature_count-1;
+			else{
+				//The information gain is assumed to be the same for all data points of the grace period, so *info_sum* stays the sum of the information gain per data point.
+				accumulate_information_gain(d_count, statistics, info_sum, static_cast<double>(unevaluated_count));
+				//The splits are ranked on the sum of information gain, which gives the same order as the average
+				for(int i = 0; i < cut_count; ++i)
+					best.add(i, info_sum[i]);
+			}
+			if(best.index[0] < 0)
+				return -1;
+			int const* best_split = best.index;
+			//With a single split, it is compared to not splitting at all
+			double const second_gain = (cut_count > 1 ? best.gain[1] : 0) / d_count;
+			double const best_gain = best.gain[0] / d_count;
+			//compute Hoeffding bound: epsilon = sqrt(R^2 * ln(1/delta) / 2n)
+			double const square_epsilon = tree->gain_range * tree->gain_range * func::log(1/tree->delta) / (2*d_count);
+			double const diff = best_gain - second_gain;
+			//Split if the best split is better than the second one with probability 1-delta, or if they are too close to ever be separated
+			bool const is_better = (diff > 0 && diff * diff > square_epsilon);
+			bool const is_tie = (square_epsilon < tree->tie_threshold * tree->tie_threshold);
+			if((is_better || is_tie) && best_gain > 0){
+				//Retrieve the feature concerned: the splits of the feature *f* start at *features_offset[f] - f*
+				int f = feature_count-1;
+				while(f > 0 && best_split[0] < tree->features_offset[f] - f)
+					f -= 1;
+				split_value = limit(f, best_split[0] - (tree->features_offset[f] - f), limits);
+				return f;
 			}
 			return -1;
 		}
@@ -249,49 +448,24 @@ class HoeffdingTree{
 		 * @param output An array of size *sum_feature_size-feature_count* where *sum_feature_size* is the sum of the number of value per feature given to the constructor of the tree.
 		 */
 		void compute_information_gain(double* output) const{
-			int* count;
-			double* limits;
-			double* info_sum;
-			int* counters[label_count];
-			for(int i = 0; i < label_count; ++i)
-				counters[i] = get_counters(i);
-			get_informations(count, limits, info_sum);
-			compute_information_gain(static_cast<double>(*count), counters, output);
-		}
-		/**
-		 * Compute information gain using given counters.
-		 * The information gain are store in *output*.
-		 * @param count_data_points The total number of data points in that node.
-		 * @param counters The counter for each label, each feature and each bin in these feature.
-		 * @param output An array of size *sum_feature_size-feature_count* where *sum_feature_size* is the sum of the number of value per feature given to the constructor of the tree.
-		 */
-		void compute_information_gain(double const count_data_points, int* counters[label_count], double* output) const{
-			double counts_per_label[label_count] = {0};
-			double entropy_leaf = 0;
-			for(int l = 0; l < label_count; ++l){
-				for(int v = 0; v < tree->features_size[0]; ++v)
-					counts_per_label[l] += counters[l][v]; //we use *v* only as index because we just access the first feature
-				double const div = (counts_per_label[l] / count_data_points);
-				if(div > 0 && !func::isnan(div))
-					entropy_leaf += div * func::log2(div);
-			}
-			entropy_leaf *= -1;
-
-			int start_index = 0;
+			double const entropy_leaf = compute_entropy(get_label_counts(), static_cast<double>(*get_count()));
 			for(int f = 0; f < feature_count; ++f){
-				//*start_index* is the index where we get the first counter for the feature *f*
+				//*start_index* is the index of the first bin of the feature *f*
 				//Remember that output is in the size of *sum_feature_size* minus *feature_count*, so we need to reduce by *f* the output
-				compute_entropy(f, start_index, counters, output + start_index - f);
-				start_index += tree->features_size[f];
+				int const start_index = tree->features_offset[f];
+				StoreEntropy entropies = {output + start_index - f};
+				sweep_cut_entropies(f, get_statistics(), entropies);
 			}
 			for(int i = 0; i < (tree->sum_feature_size-feature_count); ++i)
 				output[i] = entropy_leaf - output[i];
 		}
 		/**
-		 * Set the limits of the node.
+		 * Set the limits of the node. The observers with dynamic limits do not store limits, so it has no effect with them.
 		 * @param new_limits An array that contains the new limits. The size of the array must be at least (tree->sum_feature_size-feature_count).
 		 */
 		void set_limits(double const* new_limits){
+			if(observer::dynamic_limits)
+				return;
 			int* count;
 			double* limits;
 			double* info_sum;
@@ -301,11 +475,45 @@ class HoeffdingTree{
 		}
 
 		private:
+		/**
+		 * Add the information gain of each split, multiplied by *weight*, to *output*.
+		 * The entropy of the leaf comes from the count per label maintained during the training.
+		 * @param count_data_points The total number of data points in that node.
+		 * @param statistics The statistics of the observers for each feature.
+		 * @param output An array of size *sum_feature_size-feature_count* that accumulates the information gains.
+		 * @param weight The weight of the information gains.
+		 */
+		void accumulate_information_gain(double const count_data_points, char const* statistics, double* output, double const weight) const{
+			double const entropy_leaf = compute_entropy(get_label_counts(), count_data_points);
+			for(int f = 0; f < feature_count; ++f){
+				int const start_index = tree->features_offset[f];
+				SubtractEntropy entropies = {output + start_index - f, weight};
+				sweep_cut_entropies(f, statistics, entropies);
+			}
+			for(int i = 0; i < (tree->sum_feature_size-feature_count); ++i)
+				output[i] += weight * entropy_leaf;
+		}
+		/**
+		 * Compute the entropy of a set of data points given the count per label.
+		 * @param counts_per_label The number of data points for each label.
+		 * @param count_data_points The total number of data points.
+		 */
+		static double compute_entropy(int const* counts_per_label, double const count_data_points){
+			//Same formula as the entropy of the sides of a cut, so a cut that does not separate the data points has a gain of exactly zero
+			if(count_data_points <= 0)
+				return 0;
+			double xlogx_sum = 0;
+			for(int l = 0; l < label_count; ++l)
+				xlogx_sum += xlogx(counts_per_label[l]);
+			return (xlogx(count_data_points) - xlogx_sum) / count_data_points;
+		}
 		/**
 		 * Select the split values for each feature based on the upper and lower bound of each feature.
-		 * The limits are updated.
+		 * The limits are updated. The observers with dynamic limits do not store them, see *limit*.
 		 */
 		void select_split_values(void){
+			if(observer::dynamic_limits)
+				return;
 			int* count;
 			double* limits;
 			double* info_sum;
@@ -322,132 +530,299 @@ class HoeffdingTree{
 		}
 		/**
 		 * Overload of new operator. Return a pointer located in *tree.buffer* assuming there is enough space.
-		 * Otherwise, it returns nullptr.
+		 * A freed single node is reused first. Otherwise, it returns nullptr.
 		 * @param size The size to allocate (a must have for any new operator overload).
 		 * @param tree An additional parameter that indicates the tree of the node.
 		 */
 		void* operator new(size_t const size, HoeffdingTree& tree){
-			int const tmp_offset = tree.buffer_offset + size;
-			int const tmp_preset = tree.buffer_preset - compute_total_size_counters(tree.sum_feature_size);
-			if(tmp_offset > tmp_preset)
+			bool const reuse = (tree.free_singles != EMPTY_NODE);
+			if(!tree.has_space_for_nodes(reuse ? 0 : size, compute_total_size_counters(tree)))
 				return nullptr;
+			if(reuse)
+				return tree.pop_free_nodes(tree.free_singles);
 			auto ret = tree.buffer+tree.buffer_offset;
 			tree.buffer_offset += size;
 			return ret;
 		}
 		/**
-		 * Compute the entropy for all the cut on one feature.
-		 * The return value is set in the variable *output* and for each cut, *output[i]* contains the entropy knowing the cut i.
+		 * Overload of the placement new operator, to construct a node in memory already taken from *tree.buffer*.
+		 * @param size The size to allocate (a must have for any new operator overload).
+		 * @param place The memory of the node.
+		 */
+		void* operator new(size_t const, Node* place){
+			return place;
+		}
+		/**
+		 * Return the limit of a cut of a feature, which is stored in the leaf unless the observer has dynamic limits.
+		 * The dynamic limits split the box of the leaf in *features_size[f]* bins of equal width, as *select_split_values* does.
+		 * @param f The feature.
+		 * @param cut The index of the cut among the cuts of the feature.
+		 * @param limits The limits of the leaf (null with dynamic limits).
+		 */
+		double limit(int const f, int const cut, double const* limits) const{
+			if(observer::dynamic_limits){
+				double const width = u_box[f] - l_box[f];
+				double const step = width / tree->features_size[f];
+				return l_box[f] + (cut + 1) * step;
+			}
+			return limits[tree->features_offset[f] - f + cut];
+		}
+		/*
+		 * The outputs of *sweep_cut_entropies*, which receive the entropy of each cut of a feature.
+		 */
+		//Store the entropy of each cut
+		struct StoreEntropy{
+			double* output;
+			void set(int const cut, double const entropy){
+				output[cut] = entropy;
+			}
+		};
+		//Subtract the entropy of each cut multiplied by *weight*
+		struct SubtractEntropy{
+			double* output;
+			double weight;
+			void set(int const cut, double const entropy){
+				output[cut] -= weight * entropy;
+			}
+		};
+		//Keep the two cuts with the highest information gain (times the count), without storing the information gain of the others
+		struct BestCuts{
+			int index[2] = {-1, -1};
+			double gain[2] = {-std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity()};
+			/**
+			 * Add a cut. The cuts must be added in increasing order, so the first one wins the ties.
+			 * @param cut The index of the cut.
+			 * @param value The information gain of the cut.
+			 */
+			void add(int const cut, double const value){
+				if(value > gain[0]){
+					index[1] = index[0];
+					gain[1] = gain[0];
+					index[0] = cut;
+					gain[0] = value;
+				}
+				else if(value > gain[1]){
+					index[1] = cut;
+					gain[1] = value;
+				}
+			}
+		};
+		//Add the information gain of each cut, multiplied by *weight*, to a BestCuts
+		struct RankGain{
+			BestCuts& best;
+			int offset; //The index of the first cut of the feature
+			double weight;
+			double entropy_leaf;
+			void set(int const cut, double const entropy){
+				best.add(offset + cut, -(weight * entropy) + weight * entropy_leaf);
+			}
+		};
+		/**
+		 * Compute the entropy for all the cut on one feature in one sweep and give it to *output*.
+		 * For each cut i, *output.set(i, entropy)* is called with the entropy knowing the cut i.
+		 * The cuts are swept in increasing order and n*log2(n) is cached during the sweep: it is only recomputed for the labels whose count changes
+		 * from one cut to the next, which are the labels present in the bin between the two cuts.
+		 * Nothing is kept from one sweep to the next, so each evaluation of the splits, once per grace period, sweeps all the cuts again.
 		 * @param f The features to study. This value should be less than *feature_count*.
-		 * @param start_index The index of the first value of the feature in the counter array. Since feature have variable number of values, we need this index instead of recomputing it.
-		 * @param counters The counters for each labels at that node.
-		 * @param output An array at least in size of the number of value for the feature *f*. (*features_size[f]*)
+		 * @param statistics The statistics of the observers for each feature.
+		 * @param output The output (StoreEntropy, SubtractEntropy or RankGain).
 		 */
-		void compute_entropy(int const f, int const start_index, int* counters[label_count], double* output) const{
+		template<class output_type>
+		void sweep_cut_entropies(int const f, char const* statistics, output_type& output) const{
+			int* count;
+			double* limits;
+			double* info_sum;
+			get_informations(count, limits, info_sum);
 			int const f_size = tree->features_size[f];
-			int sides[2][label_count] = {0};
-			//Compute the sum of the counter in sides[1]
+			char const* feature_statistics = statistics + tree->statistics_offset[f];
+			int const* label_counts = get_label_counts();
+			//The count per label on the left side of the current cut, and on the left side of the previous cut
+			double left[label_count] = {0};
+			double previous_left[label_count] = {0};
+			//n*log2(n) for the count of each label on each side, cached for the sweep and only recomputed when the count changes
+			double xlogx_per_label[2][label_count];
+			double sum_per_side[2] = {0};
 			for(int l = 0; l < label_count; ++l){
-				for(int v = 0; v < f_size; ++v){
-					sides[1][l] += counters[l][start_index + v];
-				}
+				xlogx_per_label[0][l] = 0;
+				xlogx_per_label[1][l] = xlogx(label_counts[l]);
+				sum_per_side[1] += label_counts[l];
 			}
+			double const sum = sum_per_side[1];
 			//Evaluate each split
-			//*sides* will be used to keep up to date the the count for both side of the split.
 			for(int v = 0; v < (f_size-1); ++v){
-				//*sides* countains the count from both side of the split per label
-				//*sum_per_side* contains the same without the label split
-				double sum_per_side[2] = {0};
-				double probability_per_side[2] = {0};
+				//The value of the split have move forward so the observer updates the left side
+				observer::add_left_counts(feature_statistics, f_size, v, limit(f, v, limits), left);
+				double xlogx_per_side[2] = {0};
+				sum_per_side[0] = 0;
 				for(int l = 0; l < label_count; ++l){
-					//The value of the split have move forward so we update sides
-					sides[0][l] += counters[l][start_index+v];
-					sides[1][l] -= counters[l][start_index+v];
-					//Also compute the sum per side
-					sum_per_side[0] += sides[0][l];
-					sum_per_side[1] += sides[1][l];
-				}
-				double const sum = sum_per_side[0] + sum_per_side[1];
-				probability_per_side[0] = sum_per_side[0] / sum;
-				probability_per_side[1] = sum_per_side[1] / sum;
-
-				//We are computing the sum of x*log(x) for each side where x is the probability of the label *l* on both side
-				double partial_entropy[2] = {0};
-				for(int l = 0; l < label_count; ++l){
-					double const div[2] = {(sides[0][l]/sum_per_side[0]), (sides[1][l]/sum_per_side[1])};
-					if(div[0] > 0 && !func::isnan(div[0]))
-						partial_entropy[0] += div[0] * func::log2(div[0]);
-					if(div[1] > 0 && !func::isnan(div[1]))
-						partial_entropy[1] += div[1] * func::log2(div[1]);
+					if(left[l] != previous_left[l]){
+						xlogx_per_label[0][l] = xlogx(left[l]);
+						xlogx_per_label[1][l] = xlogx(label_counts[l] - left[l]);
+						previous_left[l] = left[l];
+					}
+					sum_per_side[0] += left[l];
+					xlogx_per_side[0] += xlogx_per_label[0][l];
+					xlogx_per_side[1] += xlogx_per_label[1][l];
 				}
-
-				//Fix possible NaN values
-				if(func::isnan(probability_per_side[0]))
-						probability_per_side[0] = 0;
-				if(func::isnan(probability_per_side[1]))
-						probability_per_side[1] = 0;
-
-				//Finally, we compute the entropy using the *partial_entropy* and the probability of each side
-				output[v] = (-1) * partial_entropy[0] * probability_per_side[0] + (-1) * partial_entropy[1] * probability_per_side[1];
-				//The result is store in output
+				sum_per_side[1] = sum - sum_per_side[0];
+				//The entropy of a side is log2(N) - sum(n*log2(n))/N, and it is weighted by N/sum
+				double entropy = 0;
+				if(sum > 0)
+					entropy = (xlogx(sum_per_side[0]) - xlogx_per_side[0] + xlogx(sum_per_side[1]) - xlogx_per_side[1]) / sum;
+				output.set(v, entropy);
 			}
 		}
 		/**
-		 * Retrieve the counters  for the node, assuming this is a leaf.
+		 * Return x*log2(x), or 0 when x is not positive.
+		 * @param x The value.
+		 */
+		static double xlogx(double const x){
+			return (x > 0 ? x * func::log2(x) : 0);
+		}
+		/**
+		 * Retrieve the statistics of the observers for the node, assuming this is a leaf.
 		 * Otherwise, I wouldn't dare imagening what could happen.
-		 * @param label The label for which you would like to retrieve the counter.
-		 */
-		int* get_counters(int& label) const{
-			//sum_feature_size * sizeof(int) 		-> bin counters
-			int const size_per_label = tree->sum_feature_size * sizeof(int);
-			//(sum_feature_size-feature_count) * sizeof(double)	-> limits or cut values considered 
-			// 2 time the previous					-> The sum of information gain for each cut
-			// sizeof(int) 							-> The number of data point seen so far (easy way :))
-			int const fixed_size = sizeof(int) + 2 * (tree->sum_feature_size-feature_count) * sizeof(double);
-			int const total_size_counters = fixed_size + size_per_label * label_count;
+		 * The statistics are stored in one block, feature after feature. The statistics of the feature *f* start at statistics_offset[f].
+		 */
+		char* get_statistics(void) const{
+			//statistics_size 						-> the statistics of the observers
+			//(sum_feature_size-feature_count) * sizeof(double)	-> limits or cut values considered (not stored with dynamic limits)
+			// 2 time the previous					-> The sum of information gain for each cut (not stored with dynamic limits)
+			// HEADER_SIZE							-> The number of data point seen so far (easy way :)), the number when the splits were last evaluated and the number per label
+			int const fixed_size = compute_fixed_size(*tree);
 			//NOTE: split_feature is alway negative when *this* is a leaf.
-			//So at the very least, split_feature == -1, therefore, max_size+split_feature is, at most, equal to max_size-1,
+			//So at the very least, split_feature == -1, therefore, BUFFER_SIZE+split_feature is, at most, equal to BUFFER_SIZE-1,
 			//which is within the size of the array
-			int const base_index = max_size + split_feature * total_size_counters;
-			int const counters_index = base_index + fixed_size + label * size_per_label;
+			int const base_index = BUFFER_SIZE + split_feature * compute_total_size_counters();
+			int const statistics_index = base_index + fixed_size;
 			
-			return reinterpret_cast<int*>(tree->buffer + counters_index);
+			return tree->buffer + statistics_index;
 		}
 		/**
 		 * Retrieve the counts, the limits and the sum of information gain for each limit for the node, assuming this is a leaf.
 		 * Otherwise, I wouldn't dare imagening what could happen.
+		 * With dynamic limits, the leaf stores neither the limits nor the information gains, so *limits* and *informations* are null.
 		 * @param count Output value, the number of data points in that leaf.
 		 * @param limits Output value, the limits that delimitate the bins for each feature.
 		 * @param informations The sum of information gain for each limit.
 		 */
 		void get_informations(int*& count, double*& limits, double*& informations) const{
-			int const size_per_label = tree->sum_feature_size * sizeof(int);
-			int const fixed_size = sizeof(int) + 2 * (tree->sum_feature_size-feature_count) * sizeof(double);
-			int const total_size_counters = fixed_size + size_per_label * label_count;
-
-			int const base_index = max_size + split_feature * total_size_counters;
-			int const limits_index = base_index + sizeof(int);
+			int const base_index = BUFFER_SIZE + split_feature * compute_total_size_counters();
+			int const limits_index = base_index + HEADER_SIZE;
 			int const info_sum_index = limits_index + (tree->sum_feature_size-feature_count) * sizeof(double);
-			count = reinterpret_cast<int*>(tree->buffer + base_index);
-			limits = reinterpret_cast<double*>(tree->buffer + limits_index);
-			informations = reinterpret_cast<double*>(tree->buffer + info_sum_index);
+			count = get_count();
+			limits = (observer::dynamic_limits ? nullptr : reinterpret_cast<double*>(tree->buffer + limits_index));
+			informations = (observer::dynamic_limits ? nullptr : reinterpret_cast<double*>(tree->buffer + info_sum_index));
 		}
 		/**
-		 * Compute the size needed to store the counters, the limits and their information gain values, and the count of data points.
+		 * Retrieve the number of data points in the node, assuming this is a leaf. It is followed by the number at the last evaluation of the splits and the owner.
+		 */
+		int* get_count(void) const{
+			int const base_index = BUFFER_SIZE + split_feature * compute_total_size_counters();
+			return reinterpret_cast<int*>(tree->buffer + base_index);
+		}
+		/**
+		 * Retrieve the number of data points per label for the node, assuming this is a leaf.
+		 */
+		int* get_label_counts(void) const{
+			int const base_index = BUFFER_SIZE + split_feature * compute_total_size_counters();
+			//The counts per label are right after the count of data points, the count at the last evaluation and the owner
+			return reinterpret_cast<int*>(tree->buffer + base_index) + 3;
+		}
+		/**
+		 * Compute the size needed to store the statistics, the limits and their information gain values, and the count of data points.
 		 */
 		int compute_total_size_counters(void) const{
-			return Node::compute_total_size_counters(tree->sum_feature_size);
+			return Node::compute_total_size_counters(*tree);
 		}
 		/**
-		 * Compute the size needed to store the counters, the limits and their information gain values, and the count of data points.
-		 * @param sum_feature_size The sum of bin for all features.
+		 * Compute the size needed to store the statistics, the limits and their information gain values, and the count of data points.
+		 * @param tree The tree that contains the node.
 		 */
-		static int compute_total_size_counters(int const sum_feature_size){
-			int const size_per_label = sum_feature_size * sizeof(int);
-			int const fixed_size = sizeof(int) + 2 * (sum_feature_size-feature_count) * sizeof(double);
-			int const total_size_counters = fixed_size + size_per_label * label_count;
+		static int compute_total_size_counters(HoeffdingTree const& tree){
+			int const total_size_counters = compute_fixed_size(tree) + tree.statistics_size;
 			return total_size_counters;
 		}
+		/**
+		 * Compute the size of the counters before the statistics: the header, then the limits and their information gain values unless the observer has dynamic limits.
+		 * @param tree The tree that contains the node.
+		 */
+		static int compute_fixed_size(HoeffdingTree const& tree){
+			int const limits_size = (observer::dynamic_limits ? 0 : 2 * (tree.sum_feature_size-feature_count) * sizeof(double));
+			return HEADER_SIZE + limits_size;
+		}
+		/**
+		 * Take a new block of counters at the end of the counter area and give it to the node.
+		 * The caller must make sure there is enough space.
+		 */
+		void allocate_counters(void){
+			int const total_size_counters = compute_total_size_counters();
+			int const tmp_preset = tree->buffer_preset - total_size_counters;
+			split_feature = - ((BUFFER_SIZE - tmp_preset) / total_size_counters); //we need negative number because counters are store on the other side of buffer
+			tree->buffer_preset = tmp_preset;
+			reset_counters();
+			set_owner();
+		}
+		/**
+		 * Return the index of the node in the buffer, which is also the index of its routing node.
+		 */
+		int index(void) const{
+			return this - reinterpret_cast<Node const*>(tree->buffer);
+		}
+		/**
+		 * Write the index of the node in its counters, so the counters can be moved.
+		 */
+		void set_owner(void){
+			int* count;
+			double* limits;
+			double* info_sum;
+			get_informations(count, limits, info_sum);
+			count[2] = index();
+		}
+		/**
+		 * Initialize the routing node of a new leaf. A new leaf predicts the first label until it sees data points.
+		 */
+		void init_routing(void){
+			RoutingNode& routing = tree->routing[index()];
+			routing.split_value = 0;
+			routing.split_feature = -1;
+			routing.child = 0;
+		}
+		/**
+		 * Deactivate the leaf and give its counters back.
+		 */
+		void deactivate(void){
+			release_counters();
+			split_feature = INACTIVE_LEAF;
+			tree->inactive_count += 1;
+		}
+		/**
+		 * Give the counters of the leaf back, without changing *split_feature*.
+		 * The last block of counters is moved into the freed block so the counter area stays contiguous and the space can be used by new nodes.
+		 */
+		void release_counters(void){
+			int const total_size_counters = compute_total_size_counters();
+			int const last_block = (BUFFER_SIZE - tree->buffer_preset) / total_size_counters;
+			int const block = -split_feature;
+			if(block != last_block){
+				char* destination = tree->buffer + BUFFER_SIZE - block * total_size_counters;
+				char const* source = tree->buffer + tree->buffer_preset;
+				for(int i = 0; i < total_size_counters; ++i)
+					destination[i] = source[i];
+				//Tell the owner of the last block where its counters are
+				int const owner = reinterpret_cast<int const*>(destination)[2];
+				(reinterpret_cast<Node*>(tree->buffer) + owner)->split_feature = -block;
+			}
+			tree->buffer_preset += total_size_counters;
+		}
+		/**
+		 * Reactivate the leaf with new counters. The caller must make sure there is enough space.
+		 */
+		void activate(void){
+			allocate_counters();
+			select_split_values();
+			tree->inactive_count -= 1;
+		}
 		/**
 		 * This function reset all counters and limits to zero.
 		 * NOTE: this function is not const because it modifies counter values.
@@ -457,10 +832,35 @@ class HoeffdingTree{
 		void reset_counters(void){
 
 			int const size_counters = compute_total_size_counters();
-			int const starting_index = max_size + split_feature * size_counters;
+			int const starting_index = BUFFER_SIZE + split_feature * size_counters;
 			for(int i = starting_index; i < starting_index + size_counters; ++i)
 				tree->buffer[i] = 0;
 		}
+		/**
+		 * Reset the drift detector of the node and forget its alternate subtree, which must have been freed.
+		 */
+		void reset_adaptation(void){
+			this->reset_drift(tree->detector_prototype);
+		}
+		/**
+		 * Take the place of *other* in the tree: the split, the box, the children, the labels seen and the counters of *other* are now those of the node.
+		 * @param other The node to replace.
+		 */
+		void replace_with(Node const& other){
+			split_feature = other.split_feature;
+			split_value = other.split_value;
+			for(int i = 0; i < feature_count; ++i){
+				l_box[i] = other.l_box[i];
+				u_box[i] = other.u_box[i];
+			}
+			children[0] = other.children[0];
+			children[1] = other.children[1];
+			for(int l = 0; l < label_count; ++l)
+				seen_per_label[l] = other.seen_per_label[l];
+			tree->routing[index()] = tree->routing[other.index()];
+			if(is_leaf() && !is_inactive())
+				set_owner();
+		}
 		/**
 		 * Return the left child of the node assuming the node is not a leaf.
 		 */
@@ -475,20 +875,65 @@ class HoeffdingTree{
 		}
 	};
 
+	private:
+	//The maximum number of nodes. Each node takes its size in *buffer*, a routing node and an entry of *leaf_order*, and all come out of *max_size*.
+	static int const NODE_CAPACITY = max_size / (sizeof(Node) + sizeof(RoutingNode) + sizeof(int));
+	//The size of *buffer*, which is what is left of *max_size* by the routing nodes and *leaf_order*
+	static int const BUFFER_SIZE = max_size - NODE_CAPACITY * (sizeof(RoutingNode) + sizeof(int));
+	//The buffer that will store all the node and the counters
+	char buffer[BUFFER_SIZE] = {0};
+	//The routing nodes, one per node that can fit in *buffer*
+	RoutingNode routing[NODE_CAPACITY];
+	//The heaps of leaves ordered by promise used by the memory management, one entry per node that can fit in *buffer*
+	int leaf_order[NODE_CAPACITY];
+
+	/*
+	 * The orders of the heaps of *leaf_order*. The heaps keep the greatest leaf, according to the order, at their top.
+	 * The ties are broken by index, so the leaf with the lowest index comes first.
+	 */
+	//Put the leaf with the lowest promise at the top
+	struct LowestPromiseFirst{
+		Node const* nodes;
+		bool operator()(int const a, int const b) const{
+			int const promise_a = nodes[a].promise(), promise_b = nodes[b].promise();
+			return promise_a > promise_b || (promise_a == promise_b && a > b);
+		}
+	};
+	//Put the leaf with the highest promise at the top
+	struct HighestPromiseFirst{
+		Node const* nodes;
+		bool operator()(int const a, int const b) const{
+			int const promise_a = nodes[a].promise(), promise_b = nodes[b].promise();
+			return promise_a < promise_b || (promise_a == promise_b && a > b);
+		}
+	};
+
+	public:
 	/**
 	 * The constructor of the Hoeffding Tree.
 	 * @param delta The probability of being wrong when choosing a split.
 	 * @param features_size The number of bins to use for each feature.
+	 * @param grace_period The number of data points a leaf receives between two evaluations of its splits.
+	 * @param tie_threshold The Hoeffding bound under which the two best splits are considered tied (0 disables the tie breaking).
+	 * @param memory_period The number of calls to *train* between two reactivations of the inactive leaves (0 to disable them).
 	 */
-	HoeffdingTree(double const delta, int const features_size[feature_count]){
+	HoeffdingTree(double const delta, int const features_size[feature_count], int const grace_period = 1, double const tie_threshold = 0, int const memory_period = 1000){
 		//Compute the sum of values of features
 		for(int i = 0; i < feature_count; ++i){
 			this->features_size[i] = features_size[i];
+			features_offset[i] = sum_feature_size;
 			sum_feature_size += features_size[i];
+			statistics_offset[i] = statistics_size;
+			statistics_size += observer::size(features_size[i]);
 		}
 		//This initialize the first node which is set in *buffer*
 		Node* root = new (*this) Node(*this);
 		this->delta = delta;
+		set_grace_period(grace_period);
+		this->tie_threshold = tie_threshold;
+		this->memory_period = memory_period;
+		//The information gain is at most log2(label_count)
+		this->gain_range = (label_count > 1 ? func::log2(label_count) : 1);
 	}
 	/**
 	 * Train all trees of the forest with a new data point.
@@ -497,19 +942,16 @@ class HoeffdingTree{
 	 * @param label The label of the data point.
 	 */
 	bool train(feature_type const* features, int const label){
-		Node* leaf = sort_in_leaf(features);
-		double split_value;
-		int const result = leaf->train(features, label, split_value);
-		if(result >= 0){
-			int const split_result = leaf->split(result, split_value);
-			//NOTE: it is very unlikely the node will split, so we don't check
-			if(features[result] <= split_value)
-				leaf->get_left_child()->train(features, label, split_value);
-			else
-				leaf->get_right_child()->train(features, label, split_value);
-			return (split_result == 0);
-		}
-		return true;
+		train_count += 1;
+		if(memory_period > 0 && inactive_count > 0 && train_count % memory_period == 0)
+			reorganize_leaves();
+		int const leaf_index = route(features);
+		//The internal nodes monitor their errors before the leaf learns from the data point
+		bool const replaced = adapt(features, label, leaf_index, std::integral_constant<bool, drift_detector::detects_drift>());
+		//A replaced subtree has been freed and its alternate has already been trained with the data point
+		if(replaced)
+			return true;
+		return train_leaf(reinterpret_cast<Node*>(buffer) + leaf_index, features, label);
 	}
 	/**
 	 * Predict the label of the data point.
@@ -518,7 +960,11 @@ class HoeffdingTree{
 	 * @param scores The score of each label.
 	 */
 	int predict(feature_type const* features, double* scores = nullptr){
-		Node* leaf = sort_in_leaf(features);
+		int const leaf_index = route(features);
+		//Without scores, the routing nodes are enough
+		if(scores == nullptr)
+			return routing[leaf_index].child;
+		Node* leaf = reinterpret_cast<Node*>(buffer) + leaf_index;
 		double probabilities[label_count]; //output array of predict doesn't have to be initialized :D.
 		leaf->predict(features, probabilities);
 		int best = 0;
@@ -531,6 +977,137 @@ class HoeffdingTree{
 				scores[l] = probabilities[l];
 		return best;
 	}
+	/**
+	 * Predict the labels of several data points.
+	 * The data points are routed by blocks, one level of the tree at a time for the whole block, so the memory accesses of different data points overlap.
+	 * Only the routing nodes are used unless *scores* is given.
+	 * @param features The features of the data points, stored contiguously (*count* x *feature_count*).
+	 * @param count The number of data points.
+	 * @param labels An array of size *count* that will contain the predicted labels.
+	 * @param scores If not null, an array of size *count* x *label_count* that will contain the score of each label for each data point.
+	 */
+	void predict_batch(feature_type const* features, int const count, int* labels, double* scores = nullptr){
+		int current[BATCH_BLOCK_SIZE];
+		for(int start = 0; start < count; start += BATCH_BLOCK_SIZE){
+			int const block_size = (count - start < BATCH_BLOCK_SIZE ? count - start : BATCH_BLOCK_SIZE);
+			feature_type const* block_features = features + start * feature_count;
+			for(int i = 0; i < block_size; ++i)
+				current[i] = 0;
+			//Move every data point of the block one level down until they all reach a leaf
+			bool moved = true;
+			for(int depth = 0; moved && depth < count_nodes(); ++depth){
+				moved = false;
+				for(int i = 0; i < block_size; ++i){
+					RoutingNode const& node = routing[current[i]];
+					if(node.split_feature < 0)
+						continue;
+					bool const go_right = (block_features[i * feature_count + node.split_feature] > node.split_value);
+					current[i] = node.child + go_right;
+					moved = true;
+				}
+			}
+			for(int i = 0; i < block_size; ++i){
+				labels[start + i] = routing[current[i]].child;
+				if(scores != nullptr)
+					(reinterpret_cast<Node*>(buffer) + current[i])->predict(block_features + i * feature_count, scores + (start + i) * label_count);
+			}
+		}
+	}
+	/**
+	 * Set the number of data points a leaf receives between two evaluations of its splits.
+	 * A larger grace period makes the training cheaper since most data points only update the counters.
+	 * @param grace_period The new grace period (at least 1).
+	 */
+	void set_grace_period(int const grace_period){
+		this->grace_period = (grace_period < 1 ? 1 : grace_period);
+	}
+	/**
+	 * Return the grace period.
+	 */
+	int get_grace_period(void) const{
+		return grace_period;
+	}
+	/**
+	 * Set the probability of choosing the wrong split.
+	 * @param delta The new probability, between 0 and 1.
+	 */
+	void set_delta(double const delta){
+		this->delta = delta;
+	}
+	/**
+	 * Return the probability of choosing the wrong split.
+	 */
+	double get_delta(void) const{
+		return delta;
+	}
+	/**
+	 * Set the tie threshold. When the Hoeffding bound goes under this value, the leaf splits on its best split even if the second best is as good.
+	 * A threshold of 0 disables the tie breaking.
+	 * @param tie_threshold The new tie threshold.
+	 */
+	void set_tie_threshold(double const tie_threshold){
+		this->tie_threshold = tie_threshold;
+	}
+	/**
+	 * Return the tie threshold.
+	 */
+	double get_tie_threshold(void) const{
+		return tie_threshold;
+	}
+	/**
+	 * Set the range of the information gain used in the Hoeffding bound. By default, it is log2(label_count).
+	 * @param gain_range The new range.
+	 */
+	void set_gain_range(double const gain_range){
+		this->gain_range = gain_range;
+	}
+	/**
+	 * Return the range of the information gain used in the Hoeffding bound.
+	 */
+	double get_gain_range(void) const{
+		return gain_range;
+	}
+	/**
+	 * Set how often the tree reactivates its most promising inactive leaves.
+	 * Every *memory_period* calls to *train*, inactive leaves are reactivated while there is free memory,
+	 * and swapped with the least promising active leaves when they are more promising.
+	 * @param memory_period The number of calls to *train* between two reorganizations (0 to disable them).
+	 */
+	void set_memory_period(int const memory_period){
+		this->memory_period = memory_period;
+	}
+	/**
+	 * Return how often the tree reorganizes its active and inactive leaves.
+	 */
+	int get_memory_period(void) const{
+		return memory_period;
+	}
+	/**
+	 * Return the number of leaves deactivated to save memory.
+	 */
+	int count_inactive_leaves(void) const{
+		return inactive_count;
+	}
+	/**
+	 * Set the drift detector given to the internal nodes. The detectors of the existing nodes are reset with it.
+	 * @param detector The drift detector, with its parameters, to copy in each node.
+	 */
+	void set_drift_detector(drift_detector const& detector){
+		detector_prototype = detector;
+		Node* nodes = reinterpret_cast<Node*>(buffer);
+		for(int i = 0; i < count_nodes(); ++i)
+			nodes[i].set_detector(detector);
+	}
+	/**
+	 * Return the number of alternate subtrees currently grown by the tree.
+	 */
+	int count_alternate_trees(void) const{
+		Node const* nodes = reinterpret_cast<Node const*>(buffer);
+		int count = 0;
+		for(int i = 0; i < count_nodes(); ++i)
+			count += (nodes[i].split_feature != Node::FREE_NODE && nodes[i].get_alternate() != EMPTY_NODE);
+		return count;
+	}
 	/**
 	 * Return the root of the tree.
 	 */
@@ -539,22 +1116,292 @@ class HoeffdingTree{
 	}
 	private:
 	/**
-	 * Retrieve the leaf corresponding to the data point.
+	 * Return the number of nodes in the tree.
+	 */
+	int count_nodes(void) const{
+		return buffer_offset / sizeof(Node);
+	}
+	/**
+	 * Return true if there is enough space for new nodes and new counters: the nodes must stay under NODE_CAPACITY so they have a routing node,
+	 * and the nodes and the counters must fit together in *buffer*.
+	 * @param nodes_size The size of the new nodes, in bytes.
+	 * @param counters_size The size of the new counters, in bytes.
+	 */
+	bool has_space_for_nodes(int const nodes_size, int const counters_size) const{
+		int const nodes_limit = NODE_CAPACITY * sizeof(Node);
+		return buffer_offset + nodes_size <= nodes_limit && (buffer_preset - buffer_offset) >= nodes_size + counters_size;
+	}
+	/**
+	 * Return true if there is enough space in *buffer* for the two children of a split.
+	 */
+	bool has_space_for_split(void) const{
+		//Each child is checked for a node and a block of counters, even if the left child reuses the counters of its parent
+		//A freed pair of nodes is reused first
+		int const nodes_size = (free_pairs != EMPTY_NODE ? 0 : 2 * sizeof(Node));
+		return has_space_for_nodes(nodes_size, 2 * Node::compute_total_size_counters(*this));
+	}
+	/**
+	 * Return true if there is enough space in *buffer* for a new leaf.
+	 */
+	bool has_space_for_leaf(void) const{
+		int const node_size = (free_singles != EMPTY_NODE ? 0 : sizeof(Node));
+		return has_space_for_nodes(node_size, Node::compute_total_size_counters(*this));
+	}
+	/**
+	 * Take the memory of two consecutive nodes, reusing a freed pair first. The caller must make sure there is enough space.
+	 */
+	Node* allocate_pair(void){
+		if(free_pairs != EMPTY_NODE)
+			return pop_free_nodes(free_pairs);
+		Node* pair = reinterpret_cast<Node*>(buffer + buffer_offset);
+		buffer_offset += 2 * sizeof(Node);
+		return pair;
+	}
+	/**
+	 * Remove the first nodes of a free list and return them.
+	 * @param list The free list, either *free_pairs* or *free_singles*.
+	 */
+	Node* pop_free_nodes(int& list){
+		Node* node = reinterpret_cast<Node*>(buffer) + list;
+		list = node->children[0];
+		return node;
+	}
+	/**
+	 * Mark nodes as free and add them to a free list.
+	 * @param list The free list, either *free_pairs* or *free_singles*.
+	 * @param index The index of the first node.
+	 * @param count The number of consecutive nodes (2 for *free_pairs*, 1 for *free_singles*).
+	 */
+	void push_free_nodes(int& list, int const index, int const count){
+		Node* node = reinterpret_cast<Node*>(buffer) + index;
+		for(int i = 0; i < count; ++i)
+			node[i].split_feature = Node::FREE_NODE;
+		node->children[0] = list;
+		list = index;
+	}
+	/**
+	 * Free the descendants, the alternate subtree and the counters of a node. The node itself is not freed.
+	 * @param node The root of the subtree.
+	 */
+	void free_subtree(Node* node){
+		int const alternate = node->get_alternate();
+		if(alternate != EMPTY_NODE){
+			free_subtree(reinterpret_cast<Node*>(buffer) + alternate);
+			push_free_nodes(free_singles, alternate, 1);
+			node->forget_alternate();
+		}
+		if(node->is_inactive()){
+			inactive_count -= 1;
+		}
+		else if(node->is_leaf()){
+			node->release_counters();
+		}
+		else{
+			free_subtree(node->get_left_child());
+			free_subtree(node->get_right_child());
+			push_free_nodes(free_pairs, node->children[0], 2);
+		}
+	}
+	/**
+	 * Train a leaf with a data point, and split it if needed.
+	 * Return false if the split has failed.
+	 * @param leaf The leaf.
 	 * @param features The data point.
+	 * @param label The label of the data point.
 	 */
-	Node* sort_in_leaf(feature_type const* features) {
-		//Sort into a leaf
-		Node* node  = reinterpret_cast<Node*>(buffer);
+	bool train_leaf(Node* leaf, feature_type const* features, int const label){
+		double split_value;
+		int const result = leaf->train(features, label, split_value);
+		if(result >= 0){
+			//Deactivate less promising leaves if there is not enough memory for the split
+			make_space_for_split(leaf);
+			int const split_result = leaf->split(result, split_value);
+			if(split_result != 0)
+				return false;
+			if(features[result] <= split_value)
+				leaf->get_left_child()->train(features, label, split_value);
+			else
+				leaf->get_right_child()->train(features, label, split_value);
+		}
+		return true;
+	}
+	/**
+	 * Without drift detector, the nodes do not adapt.
+	 */
+	bool adapt(feature_type const*, int const, int const, std::false_type){
+		return false;
+	}
+	/**
+	 * Give the error of the prediction to the drift detectors of the internal nodes on the path of the data point, and train their alternate subtrees.
+	 * An alternate subtree is created when a drift is detected, and it replaces the subtree of its node once its error rate is significantly lower.
+	 * Return true if a subtree has been replaced on the path, in which case the leaf has been freed.
+	 * @param features The data point.
+	 * @param label The label of the data point.
+	 * @param leaf_index The index of the leaf of the data point.
+	 */
+	bool adapt(feature_type const* features, int const label, int const leaf_index, std::true_type){
+		Node* nodes = reinterpret_cast<Node*>(buffer);
+		int const error = (routing[leaf_index].child != label);
+		int index = 0;
+		while(index != leaf_index){
+			Node* node = nodes + index;
+			if(node->detector.update(error) && node->alternate == EMPTY_NODE)
+				create_alternate(node);
+			if(node->alternate != EMPTY_NODE && train_alternate(node, features, label, error))
+				return true;
+			RoutingNode const& routing_node = routing[index];
+			index = routing_node.child + (features[routing_node.split_feature] > routing_node.split_value);
+		}
+		return false;
+	}
+	/**
+	 * Create the alternate subtree of a node, which starts as a single leaf with the box of the node.
+	 * Nothing is done if there is not enough memory.
+	 * @param node The node.
+	 */
+	void create_alternate(Node* node){
+		if(!has_space_for_leaf())
+			return;
+		Node* alternate = new (*this) Node(*this);
+		for(int i = 0; i < feature_count; ++i){
+			alternate->l_box[i] = node->l_box[i];
+			alternate->u_box[i] = node->u_box[i];
+		}
+		alternate->select_split_values();
+		node->alternate = alternate->index();
+		node->compare_count = 0;
+		node->errors = 0;
+		node->alternate_errors = 0;
+	}
+	/**
+	 * Train the alternate subtree of a node, then compare the error rates of the node and its alternate with a Hoeffding bound.
+	 * The alternate replaces the subtree of the node if it is significantly better, and it is discarded if it is significantly worse.
+	 * Return true if the subtree of the node has been replaced.
+	 * @param node The node.
+	 * @param features The data point.
+	 * @param label The label of the data point.
+	 * @param error The error of the subtree of the node on the data point.
+	 */
+	bool train_alternate(Node* node, feature_type const* features, int const label, int const error){
+		int const leaf_index = route(features, node->alternate);
+		node->alternate_errors += (routing[leaf_index].child != label);
+		node->errors += error;
+		node->compare_count += 1;
+		train_leaf(reinterpret_cast<Node*>(buffer) + leaf_index, features, label);
+		if(node->compare_count < ALTERNATE_MIN_COUNT)
+			return false;
+		double const count = static_cast<double>(node->compare_count);
+		double const error_rate = node->errors / count;
+		double const alternate_error_rate = node->alternate_errors / count;
+		double const bound = func::sqrt(2 * error_rate * (1 - error_rate) * func::log(2 / ALTERNATE_DELTA) * (2 / count));
+		if(alternate_error_rate + bound < error_rate){
+			int const alternate_index = node->alternate;
+			node->alternate = EMPTY_NODE;
+			free_subtree(node);
+			node->replace_with(*(reinterpret_cast<Node*>(buffer) + alternate_index));
+			node->reset_adaptation();
+			push_free_nodes(free_singles, alternate_index, 1);
+			return true;
+		}
+		if(alternate_error_rate - bound > error_rate){
+			free_subtree(reinterpret_cast<Node*>(buffer) + node->alternate);
+			push_free_nodes(free_singles, node->alternate, 1);
+			node->reset_adaptation();
+		}
+		return false;
+	}
+	/**
+	 * Return true if there is enough space in *buffer* for a block of counters.
+	 */
+	bool has_space_for_counters(void) const{
+		return has_space_for_nodes(0, Node::compute_total_size_counters(*this));
+	}
+	/**
+	 * Put the leaves of the tree in a heap of *leaf_order* and return the size of the heap.
+	 * @param heap The beginning of the heap in *leaf_order*.
+	 * @param inactive True to take the inactive leaves, false to take the active leaves.
+	 * @param promise_limit Only the leaves with a promise lower than this limit are taken.
+	 * @param order The order of the heap (LowestPromiseFirst or HighestPromiseFirst).
+	 */
+	template<class order_type>
+	int make_leaf_heap(int* heap, bool const inactive, int const promise_limit, order_type const& order){
+		Node const* nodes = reinterpret_cast<Node const*>(buffer);
+		int size = 0;
+		for(int i = 0; i < count_nodes(); ++i)
+			if(nodes[i].is_leaf() && nodes[i].is_inactive() == inactive && nodes[i].promise() < promise_limit)
+				heap[size++] = i;
+		std::make_heap(heap, heap + size, order);
+		return size;
+	}
+	/**
+	 * Deactivate the least promising leaves until there is enough space to split *leaf*.
+	 * Only the leaves less promising than *leaf* are deactivated. They are ordered in a heap once, so each deactivation costs O(log(leaf count)).
+	 * @param leaf The leaf about to split.
+	 */
+	void make_space_for_split(Node const* leaf){
+		if(has_space_for_split())
+			return;
+		Node* nodes = reinterpret_cast<Node*>(buffer);
+		LowestPromiseFirst const order = {nodes};
+		//*leaf* is not taken since its promise is not lower than its own
+		int size = make_leaf_heap(leaf_order, false, leaf->promise(), order);
+		while(!has_space_for_split() && size > 0){
+			std::pop_heap(leaf_order, leaf_order + size, order);
+			size -= 1;
+			nodes[leaf_order[size]].deactivate();
+		}
+	}
+	/**
+	 * Reactivate the most promising inactive leaves while there is space, then swap inactive leaves with less promising active leaves.
+	 * The inactive leaves are ordered in a heap at the beginning of *leaf_order* and the active leaves in a heap at its end,
+	 * so a reorganization costs O(leaf count * log(leaf count)).
+	 */
+	void reorganize_leaves(void){
+		Node* nodes = reinterpret_cast<Node*>(buffer);
+		HighestPromiseFirst const best_order = {nodes};
+		LowestPromiseFirst const worst_order = {nodes};
+		int const no_limit = std::numeric_limits<int>::max();
+		int best_count = make_leaf_heap(leaf_order, true, no_limit, best_order);
+		//The active leaves are only needed once there is no space left, and the two heaps cannot hold more than all the leaves
+		int* worst = leaf_order + best_count;
+		int worst_count = -1;
+		while(best_count > 0){
+			Node* best = nodes + leaf_order[0];
+			if(!has_space_for_counters()){
+				if(worst_count < 0)
+					worst_count = make_leaf_heap(worst, false, no_limit, worst_order);
+				if(worst_count == 0 || nodes[worst[0]].promise() >= best->promise())
+					return;
+				std::pop_heap(worst, worst + worst_count, worst_order);
+				worst_count -= 1;
+				nodes[worst[worst_count]].deactivate();
+			}
+			std::pop_heap(leaf_order, leaf_order + best_count, best_order);
+			best_count -= 1;
+			best->activate();
+		}
+	}
+	/**
+	 * Retrieve the index of the leaf corresponding to the data point using the routing nodes.
+	 * @param features The data point.
+	 * @param start The index of the node where the routing starts.
+	 */
+	int route(feature_type const* features, int const start = 0) const{
+		int index = start;
 		int i = 0; //The *i* counter is here to add some security and  make sure we don't loop forever
-		while(!node->is_leaf() && i < (max_size/sizeof(Node))){
-			int child_index;
-			if(features[node->split_feature] <= node->split_value) //below or equal -> left child
-				child_index = node->children[0];
-			else // right child
-				child_index = node->children[1];
-			node = reinterpret_cast<Node*>(buffer) + child_index;
+		while(routing[index].split_feature >= 0 && i < NODE_CAPACITY){
+			//below or equal -> left child, otherwise, right child
+			bool const go_right = (features[routing[index].split_feature] > routing[index].split_value);
+			index = routing[index].child + go_right;
 			i++;
 		}
-		return node;
+		return index;
+	}
+	/**
+	 * Retrieve the leaf corresponding to the data point.
+	 * @param features The data point.
+	 */
+	Node* sort_in_leaf(feature_type const* features) {
+		return reinterpret_cast<Node*>(buffer) + route(features);
 	}
 };
@@ -1,11 +1,13 @@
 #include <cassert>
 #include <cmath>
 #include <iostream>
+#include <limits>
+#include <type_traits>
 using namespace std;
 //https://github.com/mahmoodshakir/Micro-Cluster-Nearest-Neighbour-MC-NN-Algorithm
 /*
  * Implement the MC-NN algorithm.
- * - feature_type: the type of the features. They must have all the same type.
+ * - feature_type: the type of the features. They must have all the same type. Cluster statistics are stored with that type when it is a floating point type, or as double otherwise.
  * - feature_count: The number of feature per data point.
  * - max_cluster: The maximum number of cluster to use (default: 25).
  * - empty_class: the value of an empty class.
@@ -13,10 +15,14 @@ using namespace std;
 template<class feature_type, unsigned int feature_count, unsigned int max_cluster=25, int empty_class=-1>
 class MCNN{
 
+	//The type used to store the statistics of the clusters.
+	typedef typename conditional<is_floating_point<feature_type>::value, feature_type, double>::type statistic_type;
+
 	//Define an internal definition of a micro-cluster
 	struct cluster{
-		feature_type features_square_sum[feature_count];//CF2X
-		feature_type features_sum[feature_count];//CF1X
+		//The feature statistics are updated with Welford's algorithm, which stays accurate when *data_count* grows large.
+		statistic_type features_variance_sum[feature_count];//Sum of squared differences from the mean (CF2X - CF1X^2/n)
+		statistic_type features_mean[feature_count];//CF1X / n
 		double timestamp_square_sum; //CF2T
 		double timestamp_sum; //CF1T
 		unsigned int data_count;
@@ -33,10 +39,7 @@ class MCNN{
 		 * @param features_idx the index of the feature.
 		 */
 		double variance(unsigned int const features_idx) const{
-			double const a = (double)features_square_sum[features_idx] / (double)data_count; //CF2X
-			double const b = (double)features_sum[features_idx] / (double)data_count; //CF1X
-			double const ret=a - b*b;
-			return ret;
+			return static_cast<double>(features_variance_sum[features_idx]) / static_cast<double>(data_count);
 		}
 		/**
 		 * Incorporate a data point into the micro-cluster.
@@ -47,9 +50,12 @@ class MCNN{
 			timestamp_sum += timestamp;
 			timestamp_square_sum += timestamp * timestamp;
 			data_count += 1;
+			statistic_type const count = static_cast<statistic_type>(data_count);
 			for(int i = 0; i < feature_count; ++i){
-				features_sum[i] += features[i];
-				features_square_sum[i] += features[i]*features[i];
+				statistic_type const value = static_cast<statistic_type>(features[i]);
+				statistic_type const delta = value - features_mean[i];
+				features_mean[i] += delta / count;
+				features_variance_sum[i] += delta * (value - features_mean[i]);
 			}
 		}
 		/**
@@ -78,18 +84,15 @@ class MCNN{
 			error_count = starting_error; //The error count start at the threshold (contrary to what is says in the paper)
 			this->label = label;
 			for(int i = 0; i < feature_count; ++i){
-				features_sum[i] = features[i];
-				features_square_sum[i] = features[i]*features[i];
+				features_mean[i] = static_cast<statistic_type>(features[i]);
+				features_variance_sum[i] = 0;
 			}
 		}
 		/**
-		 * Compute the data point corresponding to the center of the micro-cluster.
-		 * @param features the data point of the cluster (output).
+		 * Return the data point corresponding to the center of the micro-cluster.
 		 */
-		void centroid(feature_type* features) const{
-			for(int i = 0; i < feature_count; ++i){
-				features[i] = (double)features_sum[i] / (double)data_count;
-			}
+		statistic_type const* centroid(void) const{
+			return features_mean;
 		}
 		/**
 		 * Overload of the = operator.
@@ -97,8 +100,8 @@ class MCNN{
 		cluster& operator=(const cluster& other){
 			if(this != &other){
 				for(int i = 0; i < feature_count; ++i){
-					features_square_sum[i] = other.features_square_sum[i];
-					features_sum[i] = other.features_sum[i];
+					features_variance_sum[i] = other.features_variance_sum[i];
+					features_mean[i] = other.features_mean[i];
 				}
 				timestamp_square_sum = other.timestamp_square_sum;
 				timestamp_sum = other.timestamp_sum;
@@ -111,10 +114,118 @@ class MCNN{
 		}
 	};
 
+	/*
+	 * An indexed min-heap over indexes lower than max_cluster (clusters or nodes of the participation tournament).
+	 * Each index appears at most once and its key can be updated in O(log(max_cluster)).
+	 */
+	struct cluster_heap{
+		int items[max_cluster];
+		int position[max_cluster];//Position of a cluster in *items*, -1 if the cluster is not in the heap.
+		double key[max_cluster];
+		int size = 0;
+
+		cluster_heap(void){
+			for(int i = 0; i < max_cluster; ++i)
+				position[i] = -1;
+		}
+		bool contains(int const cluster_idx) const{
+			return position[cluster_idx] >= 0;
+		}
+		bool empty(void) const{
+			return size == 0;
+		}
+		/**
+		 * Return the cluster with the lowest key. The heap must not be empty.
+		 */
+		int top(void) const{
+			return items[0];
+		}
+		/**
+		 * Insert a cluster or update its key if it is already in the heap.
+		 * @param cluster_idx the index of the cluster.
+		 * @param value the new key of the cluster.
+		 */
+		void set(int const cluster_idx, double const value){
+			key[cluster_idx] = value;
+			if(!contains(cluster_idx)){
+				items[size] = cluster_idx;
+				position[cluster_idx] = size;
+				size += 1;
+			}
+			sift_up(sift_down(position[cluster_idx]));
+		}
+		/**
+		 * Remove a cluster from the heap if it is in it.
+		 * @param cluster_idx the index of the cluster.
+		 */
+		void remove(int const cluster_idx){
+			int const pos = position[cluster_idx];
+			if(pos < 0)
+				return;
+			size -= 1;
+			position[cluster_idx] = -1;
+			if(pos == size)
+				return;
+			items[pos] = items[size];
+			position[items[pos]] = pos;
+			sift_up(sift_down(pos));
+		}
+		private:
+		void swap(int const a, int const b){
+			int const tmp = items[a];
+			items[a] = items[b];
+			items[b] = tmp;
+			position[items[a]] = a;
+			position[items[b]] = b;
+		}
+		int sift_down(int pos){
+			while(true){
+				int smallest = pos;
+				int const left = 2*pos + 1;
+				int const right = left + 1;
+				if(left < size && key[items[left]] < key[items[smallest]])
+					smallest = left;
+				if(right < size && key[items[right]] < key[items[smallest]])
+					smallest = right;
+				if(smallest == pos)
+					return pos;
+				swap(pos, smallest);
+				pos = smallest;
+			}
+		}
+		void sift_up(int pos){
+			while(pos > 0){
+				int const parent = (pos - 1) / 2;
+				if(key[items[pos]] >= key[items[parent]])
+					return;
+				swap(pos, parent);
+				pos = parent;
+			}
+		}
+	};
+
 	//An array with the maximum number of micro-cluster available
 	cluster clusters[max_cluster];
 	//An array to check if the cluster *i* is active of empty. note: we can use false to set the array because false == 0.
 	bool active[max_cluster] = {false};
+	//A stack with the index of the inactive clusters.
+	int free_slots[max_cluster];
+	int free_count = 0;
+	/*
+	 * Active clusters with more than one data point, ordered by the (triangular) time at which their participation drops below the performance threshold.
+	 * Since the participation only depends on time through the current triangular number, that key does not change as the timestamp advances;
+	 * it is only refreshed when a cluster incorporates a data point or is (re)initialized.
+	 */
+	cluster_heap cleanable;
+	/*
+	 * A tournament tree that keeps the active cluster with the lowest participation at its root.
+	 * The leaves are the clusters: the leaf of the cluster *i* is the node *max_cluster + i*, and the node *n* has the nodes *2n* and *2n+1* as children.
+	 * Each internal node keeps the cluster with the lowest participation among its children.
+	 * The participations change with the timestamp, but a cluster only overtakes another one at a time known in advance, so the nodes are kept
+	 * in a heap ordered by the time their winner gets overtaken, and only these nodes are updated when the timestamp advances.
+	 */
+	int tournament[max_cluster];
+	cluster_heap overtakings;
 	//Count the number of cluster active
 	int count_active_cluster = 0;
 	double timestamp = -1;
@@ -123,36 +234,137 @@ class MCNN{
 	unsigned int cleaning_method;
 
 
-
 	/**
-	 * Returns the micro-cluster with the lowest participation
+	 * Compute the triangular time at which the participation of a cluster falls below the performance threshold.
+	 * @param cluster_idx the index of the cluster.
 	 */
-	int get_lowest_participation(void){
-		int lowest = -1;
-		double lowest_value = 101;
-		for(int i = 0; i < max_cluster; ++i){
-			if(active[i] == true){
-				double const perf = clusters[i].performance(timestamp);
-				if(lowest == -1 || perf < lowest_value){
-					lowest_value = perf;
-					lowest = i;
-				}
-			}
+	double participation_deadline(int const cluster_idx) const{
+		cluster const& c = clusters[cluster_idx];
+		//A null threshold would make the keys infinite or undefined. Nothing is cleaned then, so any threshold keeps the heap valid.
+		double const thr = (performance_thr > 0 ? performance_thr : 50);
+		return c.triangular_number(c.initial_timestamp) + (c.timestamp_sum * 100) / thr;
+	}
+	/**
+	 * Return the cluster with the lowest participation below a node of the tournament, or -1 if none of these clusters is active.
+	 * @param node the node of the tournament.
+	 */
+	int tournament_winner(int const node) const{
+		if(node < static_cast<int>(max_cluster))
+			return tournament[node];
+		return (active[node - max_cluster] ? node - max_cluster : -1);
+	}
+	/**
+	 * Return true if the cluster *first* comes before the cluster *second* for the eviction: it has a lower participation,
+	 * or the same participation and a lower index.
+	 * @param first the index of the first cluster.
+	 * @param second the index of the second cluster.
+	 */
+	bool participates_less(int const first, int const second) const{
+		double const first_perf = clusters[first].performance(timestamp);
+		double const second_perf = clusters[second].performance(timestamp);
+		return first_perf < second_perf || (first_perf == second_perf && first < second);
+	}
+	/**
+	 * Return the triangular time from which the cluster *loser* has a lower participation than the cluster *winner*.
+	 * The participation of a cluster is 100 * timestamp_sum / (now - initial_tn), so *loser* overtakes *winner* when
+	 * loser.timestamp_sum * (now - winner_initial_tn) < winner.timestamp_sum * (now - loser_initial_tn).
+	 * Return infinity if it never happens.
+	 * @param winner the index of the cluster with the lowest participation at the triangular time *now*.
+	 * @param loser the index of the other cluster, or -1.
+	 * @param now the current triangular time.
+	 */
+	double overtaking_time(int const winner, int const loser, double const now) const{
+		if(loser < 0 || clusters[loser].timestamp_sum >= clusters[winner].timestamp_sum)
+			return numeric_limits<double>::infinity();
+		double const winner_tn = clusters[winner].triangular_number(clusters[winner].initial_timestamp);
+		double const loser_tn = clusters[loser].triangular_number(clusters[loser].initial_timestamp);
+		double const winner_sum = clusters[winner].timestamp_sum, loser_sum = clusters[loser].timestamp_sum;
+		double const time = (winner_sum * loser_tn - loser_sum * winner_tn) / (winner_sum - loser_sum);
+		//The participations are not defined yet, or are close enough to be rounded in the other order: the node is checked at the next timestamp
+		if(now <= winner_tn || now <= loser_tn || time <= now)
+			return nextafter(now, numeric_limits<double>::infinity());
+		return time;
+	}
+	/**
+	 * Recompute the winner of an internal node of the tournament from its children, and the time it gets overtaken.
+	 * @param node the internal node.
+	 * @param now the current triangular time.
+	 */
+	void play_match(int const node, double const now){
+		int const left = tournament_winner(2*node);
+		int const right = tournament_winner(2*node + 1);
+		int winner = left, loser = right;
+		if(left < 0 || (right >= 0 && participates_less(right, left))){
+			winner = right;
+			loser = left;
 		}
-		return lowest;
+		tournament[node] = winner;
+		double const time = (winner < 0 ? numeric_limits<double>::infinity() : overtaking_time(winner, loser, now));
+		if(time == numeric_limits<double>::infinity())
+			overtakings.remove(node);
+		else
+			overtakings.set(node, time);
+	}
+	/**
+	 * Recompute the winners from a node to the root of the tournament.
+	 * @param node the first node.
+	 */
+	void replay_from(int node){
+		double const now = clusters[0].triangular_number(timestamp);
+		for(; node >= 1; node /= 2)
+			play_match(node, now);
+	}
+	/**
+	 * Update the position of a cluster in the participation heap and the tournament. Must be called every time the cluster changes or is deactivated.
+	 * @param cluster_idx the index of the cluster.
+	 */
+	void refresh_participation(int const cluster_idx){
+		if(active[cluster_idx] && clusters[cluster_idx].data_count > 1)
+			cleanable.set(cluster_idx, participation_deadline(cluster_idx));
+		else
+			cleanable.remove(cluster_idx);
+		replay_from((max_cluster + cluster_idx) / 2);
+	}
+	/**
+	 * Take an inactive cluster and activate it.
+	 * @return The index of the cluster or -1 if all clusters are active.
+	 */
+	int acquire_slot(void){
+		if(free_count == 0)
+			return -1;
+		free_count -= 1;
+		int const idx = free_slots[free_count];
+		active[idx] = true;
+		count_active_cluster += 1;
+		return idx;
+	}
+	/**
+	 * Deactivate a cluster.
+	 * @param cluster_idx the index of the cluster.
+	 */
+	void release_slot(int const cluster_idx){
+		active[cluster_idx] = false;
+		count_active_cluster -= 1;
+		refresh_participation(cluster_idx);
+		free_slots[free_count] = cluster_idx;
+		free_count += 1;
+	}
+	/**
+	 * Returns the micro-cluster with the lowest participation.
+	 * The nodes of the tournament whose winner has been overtaken since the last call are updated first, then the winner is at the root.
+	 */
+	int get_lowest_participation(void){
+		double const now = clusters[0].triangular_number(timestamp);
+		while(!overtakings.empty() && overtakings.key[overtakings.top()] <= now)
+			replay_from(overtakings.top());
+		return tournament_winner(1);
 	}
 	/**
 	 * Function to split a cluster
 	 * @param cluster_idx the index of the cluster to split.
 	 */
 	void split(int const cluster_idx){
-		int new_idx = -1;
-		for(int i = 0; i < max_cluster; ++i){
-			if(!active[i] && i != cluster_idx){
-				new_idx = i;
-				break;
-			}
-		}
+		int new_idx = acquire_slot();
 		if(new_idx < 0){
 			//Remove the least performant cluster.
 			if(cleaning_method == 0 || cleaning_method == 2)
@@ -175,7 +387,7 @@ class MCNN{
 		//Create two separate feature data points based on the centroid of the original cluster
 		feature_type cluster_minus[feature_count], cluster_plus[feature_count];
 		for(int i = 0; i < feature_count; ++i){
-			cluster_minus[i] = cluster_plus[i] = clusters[cluster_idx].features_sum[i] / clusters[cluster_idx].data_count;
+			cluster_minus[i] = cluster_plus[i] = clusters[cluster_idx].features_mean[i];
 		}
 
 		//Update the spliting attribut
@@ -187,15 +399,15 @@ class MCNN{
 
 		clusters[new_idx].initialize(cluster_minus, clusters[cluster_idx].label, old_time, error_thr);
 		clusters[cluster_idx].initialize(cluster_plus, clusters[cluster_idx].label, old_time, error_thr);
-		active[new_idx] = true;
-		count_active_cluster += 1;
+		refresh_participation(new_idx);
+		refresh_participation(cluster_idx);
 	}
 	/**
 	 * Compute the squared distance between two data point.
 	 * @param e1 data point 1.
 	 * @param e2 data point 2.
 	 */
-	double euclidean_distance(feature_type const* e1, feature_type const* e2) const{
+	double euclidean_distance(feature_type const* e1, statistic_type const* e2) const{
 		double squared_sum = 0;
 		for(int i = 0; i < feature_count; ++i)
 			squared_sum += (e1[i] - e2[i]) * (e1[i] - e2[i]);
@@ -219,7 +431,6 @@ class MCNN{
 			return;
 		}
 		//Otherwise, we have to found it.
-		feature_type centroid[feature_count];
 		int nearest_cluster = -1;
 		double shortest_distance = 1000000;
 		for(int cluster_idx = 0; cluster_idx < max_cluster; ++cluster_idx){
@@ -227,8 +438,7 @@ class MCNN{
 			if(!active[cluster_idx] || clusters[cluster_idx].label != label)
 				continue;
 			//NOTE: finding both the nearest and the nearest with class could be done in one pass, but I choose to use 2 different functions to make it clearer.
-			clusters[cluster_idx].centroid(centroid);
-			double const distance = euclidean_distance(features, centroid);
+			double const distance = euclidean_distance(features, clusters[cluster_idx].centroid());
 			if(distance < shortest_distance){
 				nearest_cluster = cluster_idx;
 				shortest_distance = distance;
@@ -247,7 +457,6 @@ class MCNN{
 	 * @param shortest if not null, contains the squared distance between the data point and the nearest cluster.
 	 */
 	void find_nearest_clusters(feature_type const* features, int& nearest, double* shortest = nullptr) const{
-		feature_type centroid[feature_count];
 		int nearest_cluster = -1;
 		double shortest_distance = 1000000;
 		//Loop over the clusters
@@ -255,10 +464,8 @@ class MCNN{
 			//If the cluster is empty, skip it
 			if(!active[cluster_idx])
 				continue;
-			//Compute the centroid of the cluster
-			clusters[cluster_idx].centroid(centroid);
-			//Compute the squared euclidean distance
-			double const distance = euclidean_distance(features, centroid);
+			//Compute the squared euclidean distance to the centroid of the cluster
+			double const distance = euclidean_distance(features, clusters[cluster_idx].centroid());
 			if(distance < shortest_distance){
 				nearest_cluster = cluster_idx;
 				shortest_distance = distance;
@@ -280,9 +487,9 @@ class MCNN{
 	 * Remove the clusters with a participation lower than the performance threshold.
 	 */
 	void clean_low_performance_clusters(void){
-		for(int i = 0; i < max_cluster; ++i)
-			if(active[i] == true && clusters[i].data_count > 1 && clusters[i].performance(timestamp) < performance_thr)
-				active[i] = false;
+		//The heap is ordered by participation deadline, so we can stop at the first cluster that still performs well enough.
+		while(!cleanable.empty() && clusters[cleanable.top()].performance(timestamp) < performance_thr)
+			release_slot(cleanable.top());
 	}
 	public:
 	/**
@@ -295,6 +502,13 @@ class MCNN{
 		this->error_thr = error_thr;
 		this->performance_thr = performance_thr;
 		this->cleaning_method = cleaning_method;
+		for(int i = 0; i < max_cluster; ++i)
+			tournament[i] = -1;
+		//Stack the free slots so the lowest indexes are used first.
+		for(int i = max_cluster-1; i >= 0; --i){
+			free_slots[free_count] = i;
+			free_count += 1;
+		}
 	}
 	/**
 	 * Train the model with a new data point.
@@ -314,19 +528,17 @@ class MCNN{
 		find_nearest_clusters(features, label, nearest_index, nearest_with_class_index);
 		if(nearest_with_class_index < 0){
 			//Insert a new cluster for this class
-			for(int i = 0; i < max_cluster; ++i){
-				if(active[i] == false){
-					active[i] = true;
-					count_active_cluster += 1;
-					clusters[i].initialize(features, label, timestamp, error_thr);
-					return true;
-				}
+			int const new_idx = acquire_slot();
+			if(new_idx >= 0){
+				clusters[new_idx].initialize(features, label, timestamp, error_thr);
+				refresh_participation(new_idx);
+				return true;
 			}
 			//If we are here, there was already `max_cluster` clusters active.
 			if(cleaning_method == 0 || cleaning_method == 2){ //Cleaning method
-				int new_idx = get_lowest_participation();
-				int la = clusters[new_idx].label;
-				clusters[new_idx].initialize(features, label, timestamp, error_thr);
+				int const lowest_idx = get_lowest_participation();
+				clusters[lowest_idx].initialize(features, label, timestamp, error_thr);
+				refresh_participation(lowest_idx);
 				return true;
 			}
 			//If no cleaning has been done, then this data point is not included
@@ -341,6 +553,7 @@ class MCNN{
 			//increment error_count
 			nearest.error_count += 1;
 			nearest.incorporate(features, timestamp);
+			refresh_participation(nearest_index);
 		}
 		//else add the current record into the centroid with its class
 		else{
@@ -348,6 +561,7 @@ class MCNN{
 			nearest.error_count -= 1;
 			nearest_with_class.error_count -= 1;
 			nearest_with_class.incorporate(features, timestamp);
+			refresh_participation(nearest_with_class_index);
 			//If one of them reach error_thr, the cluster is split
 			if(nearest_with_class.error_count <= 0){
 				split(nearest_with_class_index);
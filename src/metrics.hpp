@@ -103,8 +103,14 @@ class KappaMetrics{
 	}
 };
 class ReservoirSamplingMetrics{
-	static int total_count;
 	int number;
+	/**
+	 * Return the number of metrics reset so far. The counter is a local static so the header can be included by several translation units.
+	 */
+	static int& total_count(void){
+		static int count = 0;
+		return count;
+	}
 	public:
 	ReservoirSamplingMetrics(){
 		reset();
@@ -117,18 +123,17 @@ class ReservoirSamplingMetrics{
 	void update(int const true_label, int const prediction){
 	}
 	double score(bool const invert=false, int const sample_size=1) const{
-		if(total_count == number)
-			return static_cast<double>(number - sample_size) / static_cast<double>(total_count);
-		return 1 / static_cast<double>(total_count);
+		if(total_count() == number)
+			return static_cast<double>(number - sample_size) / static_cast<double>(total_count());
+		return 1 / static_cast<double>(total_count());
 	}
 	void increase_error(int const c=1){
 	}
 	void reset(){
-		total_count += 1;
-		number = total_count;
+		total_count() += 1;
+		number = total_count();
 	}
 	bool ratio(void) const{
 		return false;
 	}
 };
-int ReservoirSamplingMetrics::total_count = 0;
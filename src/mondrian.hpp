@@ -1,4 +1,8 @@
 #include "utils.hpp"
+#include "mondrian_batch.hpp"
+#include <functional>
+#include <thread>
+#include <type_traits>
 
 /**
  * MondrianForest class implements the Mondrian Forest classifier.
@@ -12,13 +16,45 @@
  * - feature_count: the number of features for one data point.
  * - label_count: the number of different labels.
  * - max_size: the maximum size of the forest in bytes
+ * - cache_posterior_means: if true, each node caches its posterior means, so the predictions do not compute them again until the node changes.
+ *   The cache takes label_count doubles per node in *max_size*, so fewer nodes fit (false by default).
  */
-template<class feature_type, class func, int tree_count, int feature_count, int label_count, int max_size>
+template<class feature_type, class func, int tree_count, int feature_count, int label_count, int max_size, bool cache_posterior_means = false>
 class MondrianForest{
 	//Constant to define empty values at some point in the code
 	static const int EMPTY_NODE = -1;
+	/**
+	 * The posterior means cached in a node, with *cache_posterior_means*.
+	 * The posterior means of a node depend on its counters, its tau, the tau of its parent and the posterior means of its parent.
+	 * So the cache is outdated when one of them changes, and a node whose posterior means change outdates the cache of its children.
+	 */
+	template<bool cached, class dummy=void>
+	struct PosteriorCache{
+		//The posterior means of the node, computed by the predictions
+		mutable double posterior_means[label_count];
+		//True if *posterior_means* has to be computed again
+		mutable bool cache_outdated;
+		PosteriorCache(){
+			reset_cache();
+		}
+		void reset_cache(void) const{
+			for(int i = 0; i < label_count; ++i)
+				posterior_means[i] = 0;
+			cache_outdated = true;
+		}
+		void outdate_cache(void) const{
+			cache_outdated = true;
+		}
+	};
+	template<class dummy>
+	struct PosteriorCache<false, dummy>{
+		void reset_cache(void) const{
+		}
+		void outdate_cache(void) const{
+		}
+	};
 	//The node structure
-	struct Node{
+	struct Node : public PosteriorCache<cache_posterior_means>{
 		//The features used for the split
 		int split_dimension;
 		//The value used for the split
@@ -38,12 +74,7 @@ class MondrianForest{
 		 * Constuctor
 		 */
 		Node(){
-			for(int i = 0; i < label_count; ++i)
-				counters[i] = 0;
-			child_left = child_right = EMPTY_NODE;
-			split_dimension = EMPTY_NODE;
-			tau = EMPTY_NODE;
-			parent = EMPTY_NODE;
+			reset();
 		}
 		/**
 		 * Copy Constuctor
@@ -61,6 +92,18 @@ class MondrianForest{
 				bound_upper[i] = src.bound_upper[i];
 			}
 		}
+		/**
+		 * Reset the node to an empty node, as built by the constructor.
+		 */
+		void reset(void){
+			for(int i = 0; i < label_count; ++i)
+				counters[i] = 0;
+			this->reset_cache();
+			child_left = child_right = EMPTY_NODE;
+			split_dimension = EMPTY_NODE;
+			tau = EMPTY_NODE;
+			parent = EMPTY_NODE;
+		}
 		#ifdef DEBUG
 		void print(bool all = false) const{
 			cout << "Split dim: " << split_dimension << "\tSplit val: " << split_value << endl;
@@ -93,6 +136,9 @@ class MondrianForest{
 			return -1;
 		}
 	};
+	//The batch predictions call *predict_tree*
+	typedef MondrianBatch<feature_type, feature_count, label_count> Batch;
+	friend class MondrianBatch<feature_type, feature_count, label_count>;
 	//The maximum number of nodes
 	static const int MAX_NODE = (max_size - (max_size%sizeof(Node))) / sizeof(Node);
 	//The pool of node to use.
@@ -105,14 +151,47 @@ class MondrianForest{
 	double base_measure;
 	//The discount factor parameter
 	double discount_factor;
+	//The first node of the list of available nodes. The list is linked through the *child_left* of the available nodes.
+	int free_node_head;
+	//The random generator of each tree used by *train_batch*. It keeps its state between two batches.
+	XorShiftRandom generators[tree_count];
 	/**
-	 *	Return the index of an empty node.
+	 *	Return the index of an empty node and remove it from a list of available nodes, or -1 if there is none.
+	 * @param free_list The first node of the list of available nodes.
 	 */
-	int available_node(void) const{
-		for(int i = 0; i < MAX_NODE; ++i)
-			if(nodes[i].available())
-				return i;
-		return -1;
+	int available_node(int& free_list){
+		int const node_id = free_list;
+		if(node_id != EMPTY_NODE){
+			free_list = nodes[node_id].child_left;
+			nodes[node_id].child_left = EMPTY_NODE;
+		}
+		return node_id;
+	}
+	/**
+	 * Give a node back to a list of available nodes.
+	 * @param node_id The index of the node in the array *nodes*.
+	 * @param free_list The first node of the list of available nodes.
+	 */
+	void release_node(int const node_id, int& free_list){
+		nodes[node_id].reset();
+		nodes[node_id].child_left = free_list;
+		free_list = node_id;
+	}
+	/**
+	 * Update the counter of a label in the ancestors of a node.
+	 * The counter of an internal node is the number of its children with a non-zero counter, so the update stops at the first ancestor that does not change.
+	 * @param node_id The index of the node in the array *nodes*.
+	 * @param label The label to update.
+	 */
+	void update_parent_counters(int const node_id, int const label){
+		for(int parent_id = nodes[node_id].parent; parent_id != EMPTY_NODE; parent_id = nodes[parent_id].parent){
+			Node& parent = nodes[parent_id];
+			int const count = Utils::min(1, nodes[parent.child_left].counters[label]) + Utils::min(1, nodes[parent.child_right].counters[label]);
+			if(count == parent.counters[label])
+				return;
+			parent.counters[label] = count;
+			parent.outdate_cache();
+		}
 	}
 	/**
 	 * Given a node, apply the extend algorithm described in the Mondrian paper.
@@ -120,8 +199,11 @@ class MondrianForest{
 	 * @param tree_id The id of the tree the node belongs. This is used to check if the node is the root or not.
 	 * @param features The features of the new data point.
 	 * @param label The label of the new data  point.
+	 * @param free_list The list of available nodes to take the new nodes from.
+	 * @param generator The random generator.
 	 */
-	void extend_block(int const node_id, int const tree_id, feature_type const* features, int const label){
+	template<class random>
+	void extend_block(int const node_id, int const tree_id, feature_type const* features, int const label, int& free_list, random& generator){
 		//e_lower and e_upper are used to compute probabilities
 		feature_type e_lower[feature_count], e_upper[feature_count];
 		double probabilities[feature_count];
@@ -138,14 +220,14 @@ class MondrianForest{
 			sum += e_lower[i] + e_upper[i];
 		}
 		//Pick a random number following an exponential law of parameter *sum* (except if sum is 0)
-		double const E = sum == 0 ?  -1 : Utils::rand_exponential<func>(sum);
+		double const E = sum == 0 ?  -1 : Utils::rand_exponential<func>(sum, generator);
 		bool update_box = false;
 		if(E >= 0 && parent_tau + E < node.tau){//Introduce a new parent and a new sibling
 			Utils::turn_array_into_probability(probabilities, feature_count, sum);
 			//sample features with probability proportional to e_lower[i] + e_upper[i]
-			int dimension = Utils::pick_from_distribution<func>(probabilities, feature_count);
+			int dimension = Utils::pick_from_distribution(probabilities, feature_count, generator);
 			if(dimension >= feature_count || dimension < 0){
-				dimension = static_cast<int>(func::rand_uniform() * static_cast<double>(feature_count));
+				dimension = static_cast<int>(generator.rand_uniform() * static_cast<double>(feature_count));
 			}
 
 			//Select the bound to choose the split from
@@ -160,17 +242,17 @@ class MondrianForest{
 			}
 
 			//sample the split between [lower_value, upper_value]
-			double const split_value = func::rand_uniform()*(upper_value - lower_value) + lower_value;
+			double const split_value = generator.rand_uniform()*(upper_value - lower_value) + lower_value;
 			int new_parent, new_sibling;
 			//insert new node above the current one
-			new_parent = available_node();
+			new_parent = available_node(free_list);
 			if(new_parent >= 0){
 				nodes[new_parent].split_dimension = dimension;
 				nodes[new_parent].split_value = split_value;
 				nodes[new_parent].tau = parent_tau + E;
 
 				//insert new leaf, sibbling of the current one
-				new_sibling = available_node();
+				new_sibling = available_node(free_list);
 				if(new_sibling >= 0){
 
 					//Update the box of the new parent
@@ -202,6 +284,7 @@ class MondrianForest{
 
 
 					node.parent = new_parent;
+					node.outdate_cache();
 
 					nodes[new_sibling].parent = new_parent;
 					if(features[dimension] == upper_value){ //right
@@ -214,8 +297,12 @@ class MondrianForest{
 					}
 
 					sample_block(new_sibling, features, label);
+					//The new parent and its ancestors count the labels of the current node as well
+					for(int l = 0; l < label_count; ++l)
+						update_parent_counters(new_sibling, l);
 				}
 				else{
+					release_node(new_parent, free_list);
 					update_box = true;
 				}
 			}
@@ -238,15 +325,15 @@ class MondrianForest{
 			//if not leaf, recurse on the node that contains the data point
 			if(!node.is_leaf()){
 				if(features[node.split_dimension] <= node.split_value)
-					extend_block(node.child_left, tree_id, features, label);
+					extend_block(node.child_left, tree_id, features, label, free_list, generator);
 				else if(features[node.split_dimension] > node.split_value)
-					extend_block(node.child_right, tree_id, features, label);
-				//NOTE: we don't update the counters of labels here because the counting will be done when prediction is required.
-				//We can optimize that.
+					extend_block(node.child_right, tree_id, features, label, free_list, generator);
 			}
 			else{
-				//Update the counter of label
+				//Update the counter of label, and the counters of the ancestors that change
 				node.counters[label] += 1;
+				node.outdate_cache();
+				update_parent_counters(node_id, label);
 			}
 		}
 	}
@@ -265,6 +352,8 @@ class MondrianForest{
 		}
 		//Update the counter for labels
 		node.counters[label] += 1;
+		node.outdate_cache();
+		update_parent_counters(node_id, label);
 		//NOTE we don't need to check for lifetime because we only have one element
 		//see the original source code (https://github.com/balajiln/mondrianforest)
 		node.tau = lifetime;
@@ -275,12 +364,17 @@ class MondrianForest{
 	 * @param features The features of the new data point.
 	 * @param label The label of the new data  point.
 	 * @param tree_id The id of the tree which is an index between 0 and tree_count.
+	 * @param free_list The list of available nodes to take the new nodes from.
+	 * @param generator The random generator.
 	 */
-	bool train_tree(feature_type const* features, int const label, int const tree_id){
+	template<class random>
+	bool train_tree(feature_type const* features, int const label, int const tree_id, int& free_list, random& generator){
 		int root_id = roots[tree_id];
 		if (root_id == EMPTY_NODE){ //The root of the tree does not exist yet
 			//Pick a new node
-			root_id = available_node();
+			root_id = available_node(free_list);
+			if(root_id < 0)
+				return false;
 
 			//Initialize this node as the root for this tree
 			roots[tree_id] = root_id;
@@ -294,7 +388,7 @@ class MondrianForest{
 			sample_block(root_id, features, label);
 		}
 		else{ //Partial fit
-			extend_block(root_id, tree_id, features, label);
+			extend_block(root_id, tree_id, features, label, free_list, generator);
 		}
 		return true;
 	}
@@ -335,10 +429,15 @@ class MondrianForest{
 	 */
 	void predict_tree(feature_type const* features, int const tree_id, double* posterior_means) const{
 		int node_id = roots[tree_id];
+		//The posterior means of the parent of the root are the base measure
+		double base_posterior_means[label_count];
 		for(int i = 0; i < label_count; ++i)
-			posterior_means[i] = base_measure;
+			posterior_means[i] = base_posterior_means[i] = base_measure;
+		double const* parent_posterior_means = base_posterior_means;
+		//Without the cache, the posterior means of the nodes are computed in these buffers, one after the other
+		double buffers[2][label_count];
+		int node_buffer = 0;
 
-		double pp_sum = 0, pp_mul = 1;
 		double probability_of_branching;
 		double probability_not_separated_yet = 1;
 		double parent_tau = 0;
@@ -369,22 +468,24 @@ class MondrianForest{
 
 				for(int l = 0; l < label_count; ++l){
 					//posterior_means of the parent of current_node
-					double const posterior_mean = (1/c_sum) * (c[l] - new_node_discount * c[l] + c_sum * posterior_means[l]);
+					double const posterior_mean = (1/c_sum) * (c[l] - new_node_discount * c[l] + c_sum * parent_posterior_means[l]);
 					//Note that *posterior_mean* is the value for the hypothetical parent
 					smoothed_posterior_means[l] += probability_not_separated_yet * probability_of_branching * posterior_mean;
 				}
 			}
 
-			//NOTE: *posterior_means* cannot be update before we need the parent value above
-			compute_posterior_mean(current_node, posterior_means);
+			//The posterior means of the node are computed in the buffer that does not hold the ones of the parent
+			double const* node_posterior_means = get_posterior_means(current_node, parent_posterior_means, buffers[node_buffer]);
+			node_buffer = 1 - node_buffer;
 
 			//If we reach a leaf, and *posterior_means* will be set to the value for this leaf.
 			if(current_node.is_leaf()){
 				for(int l = 0; l < label_count; ++l)
-					posterior_means[l] = smoothed_posterior_means[l] + probability_not_separated_yet * (1 - probability_of_branching) * posterior_means[l];
+					posterior_means[l] = smoothed_posterior_means[l] + probability_not_separated_yet * (1 - probability_of_branching) * node_posterior_means[l];
 				break;
 			}
 			probability_not_separated_yet *= (1 - probability_of_branching);
+			parent_posterior_means = node_posterior_means;
 
 			//Otherwise, the child is picked based on the split of the node
 			if(features[current_node.split_dimension] <= current_node.split_value)
@@ -394,36 +495,97 @@ class MondrianForest{
 		}
 	}
 	/**
-	 * Update the label counters of an internal node.
-	 * It is a recursive function so if apply to the root, it will apply to an entire tree.
-	 * @param node_id The id of the node to update.
+	 * Return the posterior means of a node. They only depend on the node and its ancestors, so with *cache_posterior_means* they are cached
+	 * in the node until the node is outdated. Otherwise, they are computed in *buffer*.
+	 * @param node A reference of the node.
+	 * @param parent_posterior_means The posterior means of the parent of the node.
+	 * @param buffer An array of size label_count used when the posterior means are not cached.
 	 */
-	void update_posterior_count(int const node_id){
-		Node& node = nodes[node_id];
-		if(node.is_leaf()){
-			//A leaf should already has its count right
-			return;
-		}
-		else{ //This is an internal node
-			//Compute the posterior count for the two children
-			update_posterior_count(node.child_left);
-			update_posterior_count(node.child_right);
+	double const* get_posterior_means(Node const& node, double const* parent_posterior_means, double* buffer) const{
+		return get_posterior_means(node, parent_posterior_means, buffer, std::integral_constant<bool, cache_posterior_means>());
+	}
+	double const* get_posterior_means(Node const& node, double const* parent_posterior_means, double* buffer, std::false_type) const{
+		for(int l = 0; l < label_count; ++l)
+			buffer[l] = parent_posterior_means[l];
+		compute_posterior_mean(node, buffer);
+		return buffer;
+	}
+	double const* get_posterior_means(Node const& node, double const* parent_posterior_means, double* buffer, std::true_type) const{
+		if(node.cache_outdated){
+			for(int l = 0; l < label_count; ++l)
+				buffer[l] = parent_posterior_means[l];
+			compute_posterior_mean(node, buffer);
+			//The children only need to be computed again if the posterior means have changed
+			bool changed = false;
+			for(int l = 0; l < label_count; ++l){
+				if(node.posterior_means[l] != buffer[l]){
+					node.posterior_means[l] = buffer[l];
+					changed = true;
+				}
+			}
+			if(changed && !node.is_leaf()){
+				nodes[node.child_left].outdate_cache();
+				nodes[node.child_right].outdate_cache();
+			}
+			node.cache_outdated = false;
 		}
-		//Update each count
-		for(int i = 0; i < label_count; ++i){
-			int const c_left = Utils::min(1, nodes[node.child_left].counters[i]);
-			int const c_right = Utils::min(1, nodes[node.child_right].counters[i]);
-			node.counters[i] = c_left + c_right;
+		return node.posterior_means;
+	}
+	/**
+	 * Compute the posterior means cached in a node and all its descendants, so the predictions only read the cache.
+	 * It is a recursive function so if apply to the root, it will apply to an entire tree.
+	 * @param node_id The id of the node.
+	 * @param parent_posterior_means The posterior means of the parent of the node.
+	 */
+	void fill_posterior_cache(int const node_id, double const* parent_posterior_means) const{
+		Node const& node = nodes[node_id];
+		double buffer[label_count];
+		double const* node_posterior_means = get_posterior_means(node, parent_posterior_means, buffer);
+		if(!node.is_leaf()){
+			fill_posterior_cache(node.child_left, node_posterior_means);
+			fill_posterior_cache(node.child_right, node_posterior_means);
 		}
 	}
 	/**
-	 * Update the label counters of all trees.
+	 * Return the first tree trained by a thread of *train_batch*. The trees of thread *t* go from first_tree(t) to first_tree(t+1) excluded.
+	 * @param thread_id The index of the thread.
+	 * @param thread_count The number of threads.
 	 */
-	void update_posterior_count(void){
-		//For each tree, run the recursive *update_posterior_count* on the root
-		for(int i = 0; i < tree_count; ++i)
-			if(roots[i] != EMPTY_NODE)
-				update_posterior_count(roots[i]);
+	static int first_tree(int const thread_id, int const thread_count){
+		return thread_id * tree_count / thread_count;
+	}
+	/**
+	 * Train the trees from *first* to *last* excluded with all the data points of a batch. This is the work of one thread of *train_batch*.
+	 * @param features The features of the data points.
+	 * @param labels The labels of the data points.
+	 * @param count The number of data points.
+	 * @param first The first tree to train.
+	 * @param last The tree after the last tree to train.
+	 * @param free_list The list of available nodes of the thread.
+	 * @param trained An array of size tree_count set to true for each tree that has been fully trained.
+	 */
+	void train_trees(feature_type const* features, int const* labels, int const count, int const first, int const last, int& free_list, bool* trained){
+		//Like *train*, each data point goes through all the trees before the next one, so the trees share the memory fairly
+		for(int tree_id = first; tree_id < last; ++tree_id)
+			trained[tree_id] = true;
+		for(int i = 0; i < count; ++i)
+			for(int tree_id = first; tree_id < last; ++tree_id)
+				if(!train_tree(features + i * feature_count, labels[i], tree_id, free_list, generators[tree_id]))
+					trained[tree_id] = false;
+	}
+	/**
+	 * Append a list of available nodes at the end of another one and return the first node of the result.
+	 * @param first_list The first list.
+	 * @param second_list The list to append.
+	 */
+	int concatenate_free_lists(int const first_list, int const second_list){
+		if(first_list == EMPTY_NODE)
+			return second_list;
+		int last = first_list;
+		while(nodes[last].child_left != EMPTY_NODE)
+			last = nodes[last].child_left;
+		nodes[last].child_left = second_list;
+		return first_list;
 	}
 	public:
 	/**
@@ -439,6 +601,19 @@ class MondrianForest{
 		//Init all roots as empty
 		for(int i = 0; i < tree_count; ++i)
 			roots[i] = EMPTY_NODE;
+		//All nodes are available
+		free_node_head = (MAX_NODE > 0 ? 0 : EMPTY_NODE);
+		for(int i = 0; i < MAX_NODE; ++i)
+			nodes[i].child_left = (i + 1 < MAX_NODE ? i + 1 : EMPTY_NODE);
+		set_seed(0);
+	}
+	/**
+	 * Seed the random generators used by *train_batch*. The generator of the tree *tree_id* starts from the seed seed * tree_count + tree_id.
+	 * @param seed The seed of the random generators.
+	 */
+	void set_seed(uint64_t const seed){
+		for(int tree_id = 0; tree_id < tree_count; ++tree_id)
+			generators[tree_id] = XorShiftRandom(seed * tree_count + tree_id);
 	}
 	/**
 	 * Train all trees of the forest with a new data point.
@@ -447,23 +622,77 @@ class MondrianForest{
 	 * @param label The label of the data point.
 	 */
 	bool train(feature_type const* features, int const label){
-		bool fully_trained;
+		FuncRandom<func> generator;
+		bool fully_trained = true;
 		for(int i = 0; i < tree_count; ++i){
-			bool has_trained = train_tree(features, label, i);
+			bool has_trained = train_tree(features, label, i, free_node_head, generator);
 			if(!has_trained)
 				fully_trained = false;
 		}
 		return fully_trained;
 	}
+	/**
+	 * Train all trees of the forest with *count* data points, with the trees split between *thread_count* threads.
+	 * Each thread trains its own trees with all the data points, in order, and takes the new nodes from its own share of the available nodes.
+	 * The random numbers come from one XorShiftRandom per tree instead of *func::rand_uniform*, so the trees do not depend on the number of threads
+	 * (unless the memory runs out, since each thread only gets a share of the available nodes proportional to its number of trees).
+	 * The generators are seeded by *set_seed* and go on from one batch to the next, so training two batches is the same as training them in one batch.
+	 * Return false if a tree has failed to be trained.
+	 * @param features The features of the data points, one data point after the other (count * feature_count values).
+	 * @param labels The labels of the data points.
+	 * @param count The number of data points.
+	 * @param thread_count The number of threads. With one thread, the trees are trained by the calling thread.
+	 */
+	bool train_batch(feature_type const* features, int const* labels, int const count, int thread_count = 1){
+		if(thread_count > tree_count)
+			thread_count = tree_count;
+		if(thread_count < 1)
+			thread_count = 1;
+		//Split the list of available nodes between the threads
+		int free_lists[tree_count];
+		int available_count = 0;
+		for(int node_id = free_node_head; node_id != EMPTY_NODE; node_id = nodes[node_id].child_left)
+			available_count += 1;
+		for(int t = 0; t < thread_count; ++t){
+			int const share = available_count * (first_tree(t + 1, thread_count) - first_tree(t, thread_count)) / tree_count;
+			free_lists[t] = free_node_head;
+			int last = EMPTY_NODE;
+			for(int i = 0; i < share; ++i){
+				last = free_node_head;
+				free_node_head = nodes[free_node_head].child_left;
+			}
+			if(last != EMPTY_NODE)
+				nodes[last].child_left = EMPTY_NODE;
+			else
+				free_lists[t] = EMPTY_NODE;
+		}
+		//The nodes left by the rounding go to the last thread
+		free_lists[thread_count - 1] = concatenate_free_lists(free_lists[thread_count - 1], free_node_head);
+
+		bool trained[tree_count];
+		std::thread threads[tree_count];
+		for(int t = 1; t < thread_count; ++t)
+			threads[t] = std::thread(&MondrianForest::train_trees, this, features, labels, count, first_tree(t, thread_count), first_tree(t + 1, thread_count), std::ref(free_lists[t]), trained);
+		train_trees(features, labels, count, 0, first_tree(1, thread_count), free_lists[0], trained);
+		for(int t = 1; t < thread_count; ++t)
+			threads[t].join();
+
+		//Give the remaining nodes back to the shared list
+		free_node_head = EMPTY_NODE;
+		for(int t = thread_count - 1; t >= 0; --t)
+			free_node_head = concatenate_free_lists(free_lists[t], free_node_head);
+		bool fully_trained = true;
+		for(int i = 0; i < tree_count; ++i)
+			if(!trained[i])
+				fully_trained = false;
+		return fully_trained;
+	}
 	/**
 	 * Predict the label of the data point.
 	 * Return the most likely label.
 	 * @param features The features of the data point.
 	 */
 	int predict(feature_type const* features, double* scores = nullptr){
-		//Update internal count
-		update_posterior_count();
-
 		//The posterior mean of the forest will be the average posterior means over all trees
 		//We start by computing the sum
 		double sum_posterior_mean[label_count] = {0};
@@ -487,4 +716,27 @@ class MondrianForest{
 		}
 		return best;
 	}
+	/**
+	 * Predict the labels of *count* data points.
+	 * The data points are predicted by blocks of MondrianBatch::BATCH_BLOCK_SIZE: each tree predicts the whole block before the next tree, so its nodes stay in cache.
+	 * With several threads, each thread predicts a contiguous range of blocks.
+	 * @param features The features of the data points, one data point after the other (count * feature_count values).
+	 * @param count The number of data points.
+	 * @param labels An array of size *count* that will hold the predicted labels.
+	 * @param scores An array of size count * label_count that will hold the average posterior means of each data point, or nullptr.
+	 * @param thread_count The number of threads. With one thread, the data points are predicted by the calling thread.
+	 */
+	void predict_batch(feature_type const* features, int const count, int* labels, double* scores = nullptr, int thread_count = 1){
+		thread_count = Batch::thread_count_for(count, thread_count);
+		//The threads only read the cached posterior means, so they are all computed before
+		if(cache_posterior_means && thread_count > 1){
+			double base_posterior_means[label_count];
+			for(int l = 0; l < label_count; ++l)
+				base_posterior_means[l] = base_measure;
+			for(int i = 0; i < tree_count; ++i)
+				if(roots[i] != EMPTY_NODE)
+					fill_posterior_cache(roots[i], base_posterior_means);
+		}
+		Batch::predict(this, tree_count, features, count, labels, scores, thread_count);
+	}
 };
@@ -0,0 +1,98 @@
+#pragma once
+#include "utils.hpp"
+#include <thread>
+
+/**
+ * MondrianBatch predicts batches of data points for the Mondrian forests (MondrianForest, MondrianForestUnbound and CoarseMondrianForest).
+ * The data points are predicted by blocks of BATCH_BLOCK_SIZE: each tree predicts the whole block before the next tree, so its nodes stay in cache.
+ * With several threads, each thread predicts a contiguous range of blocks.
+ * The forests call the *predict_tree(features, tree_id, posterior_means) const* method of the forest, so the forests declare this class as a friend.
+ * Templates:
+ * - feature_type: The type of the features of the data points
+ * - feature_count: the number of features for one data point.
+ * - label_count: the number of different labels.
+ */
+template<class feature_type, int feature_count, int label_count>
+class MondrianBatch{
+	public:
+	//The number of data points predicted together
+	static int const BATCH_BLOCK_SIZE = 64;
+	//The maximum number of threads
+	static int const MAX_THREAD_COUNT = 64;
+	/**
+	 * Predict the labels of the data points from *first* to *last* excluded. This is the work of one thread of *predict_batch*.
+	 * @param forest The forest.
+	 * @param tree_count The number of trees of the forest.
+	 * @param features The features of all the data points.
+	 * @param first The first data point to predict.
+	 * @param last The data point after the last data point to predict.
+	 * @param labels The array of all the predicted labels.
+	 * @param scores The array of all the average posterior means, or nullptr.
+	 */
+	template<class forest_type>
+	static void predict_range(forest_type const* forest, int const tree_count, feature_type const* features, int const first, int const last, int* labels, double* scores){
+		double sum_posterior_means[BATCH_BLOCK_SIZE][label_count];
+		for(int start = first; start < last; start += BATCH_BLOCK_SIZE){
+			int const block_size = (last - start < BATCH_BLOCK_SIZE ? last - start : BATCH_BLOCK_SIZE);
+			feature_type const* block_features = features + start * feature_count;
+			for(int i = 0; i < block_size; ++i)
+				for(int k = 0; k < label_count; ++k)
+					sum_posterior_means[i][k] = 0;
+			for(int tree_id = 0; tree_id < tree_count; ++tree_id){
+				for(int i = 0; i < block_size; ++i){
+					double posterior_mean[label_count];
+					forest->predict_tree(block_features + i * feature_count, tree_id, posterior_mean);
+					for(int k = 0; k < label_count; ++k)
+						sum_posterior_means[i][k] += posterior_mean[k];
+				}
+			}
+			for(int i = 0; i < block_size; ++i){
+				for(int k = 0; k < label_count; ++k)
+					sum_posterior_means[i][k] /= static_cast<double>(tree_count);
+				labels[start + i] = Utils::index_max(sum_posterior_means[i], label_count);
+				if(scores != nullptr)
+					for(int k = 0; k < label_count; ++k)
+						scores[(start + i) * label_count + k] = sum_posterior_means[i][k];
+			}
+		}
+	}
+	/**
+	 * Return the number of threads used to predict *count* data points: at least one, and at most one per block and MAX_THREAD_COUNT.
+	 * @param count The number of data points.
+	 * @param thread_count The number of threads asked by the caller.
+	 */
+	static int thread_count_for(int const count, int thread_count){
+		int const block_count = (count + BATCH_BLOCK_SIZE - 1) / BATCH_BLOCK_SIZE;
+		if(thread_count > block_count)
+			thread_count = block_count;
+		if(thread_count > MAX_THREAD_COUNT)
+			thread_count = MAX_THREAD_COUNT;
+		if(thread_count < 1)
+			thread_count = 1;
+		return thread_count;
+	}
+	/**
+	 * Predict the labels of *count* data points, with the blocks split between *thread_count* threads.
+	 * The forest must be ready to be read by several threads at once.
+	 * @param forest The forest.
+	 * @param tree_count The number of trees of the forest.
+	 * @param features The features of the data points, one data point after the other (count * feature_count values).
+	 * @param count The number of data points.
+	 * @param labels An array of size *count* that will hold the predicted labels.
+	 * @param scores An array of size count * label_count that will hold the average posterior means of each data point, or nullptr.
+	 * @param thread_count The number of threads, as returned by *thread_count_for*. With one thread, the data points are predicted by the calling thread.
+	 */
+	template<class forest_type>
+	static void predict(forest_type const* forest, int const tree_count, feature_type const* features, int const count, int* labels, double* scores, int const thread_count){
+		int const block_count = (count + BATCH_BLOCK_SIZE - 1) / BATCH_BLOCK_SIZE;
+		std::thread threads[MAX_THREAD_COUNT];
+		for(int t = 1; t < thread_count; ++t){
+			int const first = (t * block_count / thread_count) * BATCH_BLOCK_SIZE;
+			int const last = Utils::min(((t + 1) * block_count / thread_count) * BATCH_BLOCK_SIZE, count);
+			threads[t] = std::thread(&MondrianBatch::predict_range<forest_type>, forest, tree_count, features, first, last, labels, scores);
+		}
+		predict_range(forest, tree_count, features, 0, Utils::min((block_count / thread_count) * BATCH_BLOCK_SIZE, count), labels, scores);
+		for(int t = 1; t < thread_count; ++t)
+			threads[t].join();
+	}
+};
@@ -1,35 +1,72 @@
 #include "utils.hpp"
+#include "mondrian_batch.hpp"
 #include "metrics.hpp"
 #include <typeinfo>
 #include <iostream>
+#include <thread>
+#include <limits>
+#include <type_traits>
+#include <stdint.h>
 using namespace std;
 #ifdef DEBUG
 #include <iostream>
 using namespace std;
 #endif
-template<int feature_count, int label_count>
+/**
+ * Counter stored in a small integer type. It stops at the maximum value of the type instead of wrapping around.
+ * Templates:
+ * - T: the integer type that stores the counter (at most the size of an int).
+ */
+template<class T>
+class SaturatingCounter{
+	T value;
+	public:
+	SaturatingCounter(int const v = 0){
+		int const maximum = static_cast<int>(std::numeric_limits<T>::max());
+		int const minimum = static_cast<int>(std::numeric_limits<T>::min());
+		value = static_cast<T>(v > maximum ? maximum : (v < minimum ? minimum : v));
+	}
+	SaturatingCounter& operator+=(int const v){
+		return *this = SaturatingCounter(static_cast<int>(value) + v);
+	}
+	operator int() const{
+		return static_cast<int>(value);
+	}
+};
+/**
+ * The node of CoarseMondrianForest.
+ * Templates:
+ * - feature_count: the number of features for one data point.
+ * - label_count: the number of different labels.
+ * - value_type: the type of the bounds, the split value, tau and the fading score.
+ * - index_type: the signed integer type of the links between nodes and of the split dimension. It limits the number of nodes of the forest.
+ * - counter_type: the integer type of the label counters. A type smaller than an int is stored in a SaturatingCounter, so the counters stop at its maximum value.
+ */
+template<int feature_count, int label_count, class value_type = double, class index_type = int, class counter_type = int>
 struct MondrianNode{
 	//Constant to define empty values at some point in the code
 	static const int EMPTY_NODE = -1;
+	//The maximum number of nodes the links between nodes can address
+	static const int MAX_NODE_COUNT = std::numeric_limits<index_type>::max();
 	//The features used for the split
-	int split_dimension;
+	index_type split_dimension;
 	//The value used for the split
-	double split_value;
+	value_type split_value;
 	//The smallest box at that node that contains all training data points who reached that node
-	double bound_lower[feature_count];
-	double bound_upper[feature_count];
+	value_type bound_lower[feature_count];
+	value_type bound_upper[feature_count];
 
 	//Connexion between nodes.
 	//NOTE: if parent == EMPTY_NODE, the node is a root
-	int child_left, child_right, parent;
+	index_type child_left, child_right, parent;
 	//The lifetime of the node. This parameter control the growth of a tree.
-	double tau;
+	value_type tau;
 	//The counters of each labels that reach that node.
-	int counters[label_count];
+	typename std::conditional<(sizeof(counter_type) < sizeof(int)), SaturatingCounter<counter_type>, counter_type>::type counters[label_count];
 	//Counter of element that should have been out of the box, but couldn't because of lack of memory
 	int forced_extend;
 	//Contain a score for the node.
-	double fading_score;
+	value_type fading_score;
 
 	/**
 	 * Constuctor
@@ -62,10 +99,22 @@ struct MondrianNode{
 	 * Copy Constuctor
 	 */
 	MondrianNode(MondrianNode const& src){
+		copy(src);
+	}
+	void operator=(MondrianNode const& node){
+		if(&node != this)
+			copy(node);
+	}
+	/**
+	 * Copy all the fields of another node.
+	 * @param src The node to copy.
+	 */
+	void copy(MondrianNode const& src){
 		split_dimension = src.split_dimension;
 		split_value = src.split_value;
 		child_left = src.child_left;
 		child_right = src.child_right;
+		parent = src.parent;
 		tau = src.tau;
 		for(int i = 0; i < label_count; ++i)
 			counters[i] = src.counters[i];
@@ -73,23 +122,8 @@ struct MondrianNode{
 			bound_lower[i] = src.bound_lower[i];
 			bound_upper[i] = src.bound_upper[i];
 		}
-	}
-	void operator=(MondrianNode const& node){
-		if(&node != this){
-			split_dimension = node.split_dimension;
-			split_value = node.split_value;
-			child_left = node.child_left;
-			child_right = node.child_right;
-			parent = node.parent;
-			tau = node.tau;
-			for(int i = 0; i < feature_count; ++i){
-				bound_lower[i] = node.bound_lower[i];
-				bound_upper[i] = node.bound_upper[i];
-			}
-			for(int i = 0; i < label_count; ++i){
-				counters[i] = node.counters[i];
-			}
-		}
+		forced_extend = src.forced_extend;
+		fading_score = src.fading_score;
 	}
 	#ifdef DEBUG
 	void print(bool all = false) const{
@@ -123,6 +157,17 @@ struct MondrianNode{
 		return -1;
 	}
 };
+/**
+ * Compact MondrianNode for CoarseMondrianForest, to fit more nodes in the same memory: the values are stored as float,
+ * the links between nodes as *index_type* and the label counters as *counter_type*.
+ * Templates:
+ * - feature_count: the number of features for one data point.
+ * - label_count: the number of different labels.
+ * - counter_type: the integer type of the label counters. The counters stop at its maximum value.
+ * - index_type: the signed integer type of the links between nodes. It limits the number of nodes of the forest.
+ */
+template<int feature_count, int label_count, class counter_type = uint16_t, class index_type = int16_t>
+using CompactMondrianNode = MondrianNode<feature_count, label_count, float, index_type, counter_type>;
 #define DO_DELETE 0
 #define DONT_DELETE 1
 
@@ -161,6 +206,45 @@ struct MondrianNode{
 #define TRIM_FADING 2
 #define TRIM_COUNT 3
 
+/**
+ * Strategies of CoarseMondrianForest chosen at runtime by the parameters of its constructor.
+ * This is the default strategy, convenient for experiments that try several strategies with one build.
+ */
+struct RuntimeMondrianStrategy{
+	int const tree_management;
+	int const fe_distribution;
+	int const fe_split_trigger;
+	int const split_helper;
+	int const extend_type;
+	int const trim_type;
+	RuntimeMondrianStrategy(int const tm, int const fed, int const fes, int const sh, int const et, int const tt):
+		tree_management(tm), fe_distribution(fed), fe_split_trigger(fes), split_helper(sh), extend_type(et), trim_type(tt) {
+	}
+};
+/**
+ * Strategies of CoarseMondrianForest chosen at compile time.
+ * The strategies are constants, so the compiler removes the code of the other strategies from the extend, split and train functions.
+ * The corresponding parameters of the constructor of CoarseMondrianForest are ignored.
+ * Templates:
+ * - tm: the tree management (COBBLE_MANAGEMENT, ROBUR_MANAGEMENT, ...).
+ * - fed: the distribution of the forced extends (FE_DISTRIBUTION_*).
+ * - fes: the split trigger of the forced extends (SPLIT_TRIGGER_*).
+ * - sh: the split helper (SPLIT_HELPER_*).
+ * - et: the extend type (EXTEND_*).
+ * - tt: the trim type (TRIM_*).
+ */
+template<int tm, int fed = FE_DISTRIBUTION_ZERO, int fes = SPLIT_TRIGGER_NONE, int sh = SPLIT_HELPER_NONE, int et = EXTEND_NONE, int tt = TRIM_NONE>
+struct StaticMondrianStrategy{
+	static const int tree_management = tm;
+	static const int fe_distribution = fed;
+	static const int fe_split_trigger = fes;
+	static const int split_helper = sh;
+	static const int extend_type = et;
+	static const int trim_type = tt;
+	StaticMondrianStrategy(int const, int const, int const, int const, int const, int const){
+	}
+};
+
 
 /**
 * MondrianForest class implements the Mondrian Forest classifier.
@@ -174,26 +258,46 @@ struct MondrianNode{
 * - feature_count: the number of features for one data point.
 * - label_count: the number of different labels.
 * - max_size: the maximum size of the forest in bytes
+* - node_type: the structure of the nodes, MondrianNode<feature_count, label_count> by default. CompactMondrianNode fits more nodes in *max_size*.
+* - strategy: where the strategies (tree management, forced extends, split helper, extend and trim types) come from.
+*   RuntimeMondrianStrategy (default) takes them from the constructor, StaticMondrianStrategy fixes them at compile time.
+* - cache_posterior_means: if true, each node caches its posterior means, so the predictions do not compute them again until the trees change.
+*   The cache takes label_count doubles per node in *max_size*, so fewer nodes fit (false by default).
 */
-template<class feature_type, class func, class Statistic, int feature_count, int label_count, int max_size>
-class CoarseMondrianForest{
-typedef MondrianNode<feature_count, label_count> Node;
+template<class feature_type, class func, class Statistic, int feature_count, int label_count, int max_size, class node_type = MondrianNode<feature_count, label_count>, class strategy = RuntimeMondrianStrategy, bool cache_posterior_means = false>
+class CoarseMondrianForest : private strategy{
+/**
+ * A node with its posterior means cached, with *cache_posterior_means*.
+ * The nodes are changed by many strategies (extends, trims, resets of trees), so the cache is not outdated node by node:
+ * it is valid while *cache_generation* is the one of the forest, which changes every time the trees may have changed.
+ */
+struct CachedNode : public node_type{
+	//The posterior means of the node, computed by the predictions
+	mutable double posterior_means[label_count];
+	//The generation of the forest when *posterior_means* were computed
+	mutable uint64_t cache_generation;
+	void reset(void){
+		node_type::reset();
+		cache_generation = 0;
+	}
+};
+typedef typename std::conditional<cache_posterior_means, CachedNode, node_type>::type Node;
 
+using strategy::tree_management;
+using strategy::fe_distribution;
+using strategy::fe_split_trigger;
+using strategy::split_helper;
+using strategy::extend_type;
+using strategy::trim_type;
 
-int const tree_management;
 int const size_type;
 int size_limit;
 int const dont_delete;
 bool const print_nodes;
-int const fe_distribution;
-int const fe_split_trigger;
 double const tau_factor;
 bool const generate_full_point;
 bool const reset_once;
 double const fe_parameter;
-int const split_helper;
-int const extend_type;
-int const trim_type;
 
 //The node structure
 	public:
@@ -231,6 +335,9 @@ struct TreeBase{
 	}
 };
 private:
+//The batch predictions call *predict_tree*
+typedef MondrianBatch<feature_type, feature_count, label_count> Batch;
+friend class MondrianBatch<feature_type, feature_count, label_count>;
 
 unsigned char buffer[max_size];
 
@@ -245,6 +352,12 @@ int node_usage_on_ltd = 0;
 //The number of nodes
 int node_count = 0;
 int node_available = 0;
+//The first node of the list of available nodes. The list is linked through the *child_left* of the available nodes.
+int free_node_head = -1;
+//True if the trees may have changed since the last update of the label counters of the internal nodes
+bool counters_outdated = true;
+//The posterior means cached in the nodes are valid if they have been computed at this generation
+mutable uint64_t cache_generation = 1;
 //The number of trees
 int tree_count = 0;
 int maximum_tree_count = 0;
@@ -275,20 +388,38 @@ TreeBase const* tree_bases() const{
 	return reinterpret_cast<TreeBase const*>(buffer + max_size - tree_count * sizeof(TreeBase));
 }
 /**
- *	Return the index of an empty node.
+ *	Return the index of an empty node and remove it from the list of available nodes, or -1 if there is none.
  */
-int available_node(void) const{
-	if(node_available == 0)
+int available_node(void){
+	int const node_id = free_node_head;
+	if(node_available == 0 || node_id == Node::EMPTY_NODE)
 		return -1;
-	static int last_returned_node = 0;
-	for(int i = 0; i < node_count; ++i){
-		int const node_id = (i + last_returned_node) % node_count;
-		if(nodes()[node_id].available()){
-			last_returned_node = node_id;
-			return node_id;
+	free_node_head = nodes()[node_id].child_left;
+	nodes()[node_id].child_left = Node::EMPTY_NODE;
+	return node_id;
+}
+/**
+ * Reset a node and give it back to the list of available nodes. The caller updates *node_available*.
+ * @param node_id The index of the node in the array *nodes*.
+ */
+void release_node(int const node_id){
+	Node& node = nodes()[node_id];
+	node.reset();
+	node.child_left = free_node_head;
+	free_node_head = node_id;
+}
+/**
+ * Rebuild the list of available nodes from the nodes of the pool. It is called when the size of the pool changes.
+ */
+void rebuild_free_list(void){
+	free_node_head = Node::EMPTY_NODE;
+	for(int node_id = node_count - 1; node_id >= 0; --node_id){
+		Node& node = nodes()[node_id];
+		if(node.available()){
+			node.child_left = free_node_head;
+			free_node_head = node_id;
 		}
 	}
-	return -1;
 }
 /**
  * Given a node, apply the extend algorithm described in the Mondrian paper.
@@ -365,7 +496,7 @@ void extend_block0(int const node_id, int const tree_id, feature_type const* fea
 		}
 		//NOTE Creates counters for the label of the new parent
 		for(int i = 0; i < label_count; ++i)
-			nodes()[new_parent].counters[i] = Utils::min(1, node.counters[i]);
+			nodes()[new_parent].counters[i] = Utils::min<int>(1, node.counters[i]);
 
 		//Creates counters for the label of the new sibling
 		for(int i = 0; i < label_count; ++i)
@@ -1010,8 +1141,8 @@ void split_node(int const node_id, int const tree_id, feature_type const* featur
 	//Set the box for the new children and the new_parent and the node (depending on the values in features
 	//The current datapoint is passed through after readjusting counters and shape
 	for(int i = 0; i < feature_count; ++i){
-		new_parent.bound_lower[i] = Utils::min(node.bound_lower[i], features[i]);
-		new_parent.bound_upper[i] = Utils::max(node.bound_upper[i], features[i]);
+		new_parent.bound_lower[i] = Utils::min<double>(node.bound_lower[i], features[i]);
+		new_parent.bound_upper[i] = Utils::max<double>(node.bound_upper[i], features[i]);
 		new_sibling.bound_lower[i] = node.bound_lower[i];
 		new_sibling.bound_upper[i] = node.bound_upper[i];
 	}
@@ -1148,8 +1279,8 @@ bool split_barycenter(int const node_id, int const tree_id, feature_type const*
 	//Set the box for the new children and the new_parent and the node (depending on the values in features
 	//The current datapoint is passed through after readjusting counters and shape
 	for(int i = 0; i < feature_count; ++i){
-		new_parent.bound_lower[i] = Utils::min(node.bound_lower[i], features[i]);
-		new_parent.bound_upper[i] = Utils::max(node.bound_upper[i], features[i]);
+		new_parent.bound_lower[i] = Utils::min<double>(node.bound_lower[i], features[i]);
+		new_parent.bound_upper[i] = Utils::max<double>(node.bound_upper[i], features[i]);
 		new_sibling.bound_lower[i] = node.bound_lower[i];
 		new_sibling.bound_upper[i] = node.bound_upper[i];
 	}
@@ -1378,8 +1509,8 @@ int adjust_boxes(int const start_id, int const split_dimension, double const spl
 					Node& replacer = nodes()[replacer_id];
 					if(is_root){ //The root is replaced by one of the children
 						tree_bases()[tree_id].root = replacer_id;
-						nodes()[other_id].reset();
-						node.reset();
+						release_node(other_id);
+						release_node(node_id);
 						nodes()[replacer_id].parent = -1;
 						node_available += 2;
 						break;
@@ -1393,10 +1524,11 @@ int adjust_boxes(int const start_id, int const split_dimension, double const spl
 						replacer.parent = node.parent;
 					}
 					//Set the id to keep exploring the tree before the reset
+					int const removed_id = node_id;
 					node_id = node.parent;
 					//reset other_id and node
-					nodes()[other_id].reset();
-					node.reset();
+					release_node(other_id);
+					release_node(removed_id);
 					node_available += 2;
 					if(is_starting)
 						break;
@@ -1511,8 +1643,8 @@ int pass_data_point_down(int const start_id, feature_type const* features, int c
 		Node& node = nodes()[node_id];
 		//Update box size
 		for(int i = 0; i < feature_count; ++i){
-			double const lower = Utils::min(node.bound_lower[i], features[i]);
-			double const upper = Utils::max(node.bound_upper[i], features[i]);
+			double const lower = Utils::min<double>(node.bound_lower[i], features[i]);
+			double const upper = Utils::max<double>(node.bound_upper[i], features[i]);
 			node.bound_lower[i] = lower;
 			node.bound_upper[i] = upper;
 		}
@@ -1891,7 +2023,8 @@ int tree_fade_counts(int const tree_id){
 private:
 void cut_block(int const node_id, int const tree_id){
 	Node& node = nodes()[node_id];
-	Node& parent = nodes()[node.parent];
+	int const parent_id = node.parent;
+	Node& parent = nodes()[parent_id];
 	int sibling_id;
 	if(parent.child_right == node_id)
 		sibling_id = parent.child_left;
@@ -1900,7 +2033,7 @@ void cut_block(int const node_id, int const tree_id){
 	Node& sibling = nodes()[sibling_id];
 
 	if(parent.parent == -1){ //Place the other sibling as root (behead)
-		parent.reset();
+		release_node(parent_id);
 		node_available += 1;
 		node_reset(node_id);
 		//Cut off node and everything below
@@ -1916,7 +2049,7 @@ void cut_block(int const node_id, int const tree_id){
 		grandparent.child_left = sibling_id;
 	sibling.parent = parent.parent;
 	node_available += 1;
-	parent.reset();
+	release_node(parent_id);
 	//TODO remove the counters?
 	node_reset(node_id);
 }
@@ -2017,6 +2150,7 @@ void sample_block(int const node_id, feature_type const* features, int const lab
  * @param tree_id The id of the tree which is an index between 0 and tree_count.
  */
 bool train_tree(feature_type const* features, int const label, int const tree_id){
+	outdate_trees();
 	int root_id;
 	TreeBase& base = tree_bases()[tree_id];
 	bool ret = true;
@@ -2085,7 +2219,7 @@ void compute_posterior_mean(Node const& node, double *posterior_mean) const{
 	//Compute sum_counters and sum_tab, and set tab
 	for(int i = 0; i < label_count; ++i){
 		sum_counters += node.counters[i];
-		tab[i] = Utils::min(node.counters[i], 1);
+		tab[i] = Utils::min<int>(node.counters[i], 1);
 		sum_tab += tab[i];
 	}
 	//For each label with a counter higher than zero, compute the posterior mean. Otherwise it is simply the posterior mean of the parent
@@ -2097,6 +2231,47 @@ void compute_posterior_mean(Node const& node, double *posterior_mean) const{
 		}
 	}
 }
+/**
+ * Turn the posterior means of the parent of a node into the posterior means of the node. They only depend on the node and its ancestors,
+ * so with *cache_posterior_means* they are cached in the node until the trees change. Otherwise, they are computed by *compute_posterior_mean*.
+ * @param node A reference of the node.
+ * @param posterior_means The posterior means of the parent. They will be turned into the posterior means of the node.
+ */
+void get_posterior_means(Node const& node, double* posterior_means) const{
+	get_posterior_means(node, posterior_means, std::integral_constant<bool, cache_posterior_means>());
+}
+void get_posterior_means(Node const& node, double* posterior_means, std::false_type) const{
+	compute_posterior_mean(node, posterior_means);
+}
+void get_posterior_means(Node const& node, double* posterior_means, std::true_type) const{
+	if(node.cache_generation != cache_generation){
+		compute_posterior_mean(node, posterior_means);
+		for(int l = 0; l < label_count; ++l)
+			node.posterior_means[l] = posterior_means[l];
+		node.cache_generation = cache_generation;
+	}
+	else{
+		for(int l = 0; l < label_count; ++l)
+			posterior_means[l] = node.posterior_means[l];
+	}
+}
+/**
+ * Compute the posterior means cached in a node and all its descendants, so the predictions only read the cache.
+ * It is a recursive function so if apply to the root, it will apply to an entire tree.
+ * @param node_id The id of the node.
+ * @param parent_posterior_means The posterior means of the parent of the node.
+ */
+void fill_posterior_cache(int const node_id, double const* parent_posterior_means) const{
+	Node const& node = nodes()[node_id];
+	double posterior_means[label_count];
+	for(int l = 0; l < label_count; ++l)
+		posterior_means[l] = parent_posterior_means[l];
+	get_posterior_means(node, posterior_means);
+	if(!node.is_leaf()){
+		fill_posterior_cache(node.child_left, posterior_means);
+		fill_posterior_cache(node.child_right, posterior_means);
+	}
+}
 /**
  * Return the posterior means of the leaf of a data point in the tree *tree_id*. This is the prediction of the tree.
  * The data point go through the tree until it reach a leaf, then the posterior means of this leaf (or its virtual sibling) is returned.
@@ -2138,7 +2313,7 @@ void predict_tree(feature_type const* features, int const tree_id, double* poste
 			double c_sum = 0;
 			//We need the sum of *c*, so we need two loops
 			for(int l = 0; l < label_count; ++l){
-				c[l] = Utils::min(current_node.counters[l], 1);
+				c[l] = Utils::min<int>(current_node.counters[l], 1);
 				c_sum += c[l];
 			}
 
@@ -2151,7 +2326,7 @@ void predict_tree(feature_type const* features, int const tree_id, double* poste
 		}
 
 		//NOTE: *posterior_means* cannot be update before we need the parent value above
-		compute_posterior_mean(current_node, posterior_means);
+		get_posterior_means(current_node, posterior_means);
 
 		//If we reach a leaf, and *posterior_means* will be set to the value for this leaf.
 		bool too_deep = (depth+1 >= depth_limit) && (depth_limit >= 0);
@@ -2199,8 +2374,8 @@ void update_posterior_count(int const tree_id, feature_type const* features, int
 	node_id = nodes()[node_id].parent;
 	while(node_id > 0 && node_id < node_count){
 		Node& node = nodes()[node_id];
-		int const c_left = Utils::min(1, nodes()[node.child_left].counters[label]);
-		int const c_right = Utils::min(1, nodes()[node.child_right].counters[label]);
+		int const c_left = Utils::min<int>(1, nodes()[node.child_left].counters[label]);
+		int const c_right = Utils::min<int>(1, nodes()[node.child_right].counters[label]);
 		node.counters[label] = c_left + c_right;
 		//TODO check validity of that if
 		//if(node.counters[i] == 2)
@@ -2226,8 +2401,8 @@ void update_posterior_count(int const node_id){
 	}
 	//Update each count
 	for(int i = 0; i < label_count; ++i){
-		int const c_left = Utils::min(1, nodes()[node.child_left].counters[i]);
-		int const c_right = Utils::min(1, nodes()[node.child_right].counters[i]);
+		int const c_left = Utils::min<int>(1, nodes()[node.child_left].counters[i]);
+		int const c_right = Utils::min<int>(1, nodes()[node.child_right].counters[i]);
 		node.counters[i] = c_left + c_right;
 	}
 }
@@ -2235,11 +2410,24 @@ void update_posterior_count(int const node_id){
  * Update the label counters of all trees.
  */
 void update_posterior_count(void){
+	//The update only depends on the counters of the leaves, so it is skipped if the trees have not changed
+	if(!counters_outdated)
+		return;
 	//For each tree, run the recursive *update_posterior_count* on the root
 	TreeBase* bases = tree_bases();
 	for(int i = 0; i < tree_count; ++i)
 		if(!bases[i].is_empty())
 			update_posterior_count(bases[i].root);
+	counters_outdated = false;
+	//The posterior means depend on the counters
+	++cache_generation;
+}
+/**
+ * Note that the trees may have changed, so the label counters of the internal nodes and the cached posterior means have to be computed again.
+ */
+void outdate_trees(void){
+	counters_outdated = true;
+	++cache_generation;
 }
 double average_tree_size(void) const{
 	double sum = 0;
@@ -2365,14 +2553,15 @@ bool node_reset(int const start_id) {
 			i += 1;
 
 			if(node_id == root_id){
-				node.reset();
+				release_node(node_id);
 				break;
 			}
 
 			//Get the parent before reset (root parent will be a negative number)
 			//Since the loop stops if node_id is below 0, it's fine
+			int const removed_id = node_id;
 			node_id = node.parent;
-			node.reset();
+			release_node(removed_id);
 
 			depth -= 1;
 		}
@@ -2391,7 +2580,7 @@ bool node_reset(int const start_id) {
 				node_available += 1;
 
 				if(node_id == root_id){
-					node.reset();
+					release_node(node_id);
 					break;
 				}
 
@@ -2401,8 +2590,9 @@ bool node_reset(int const start_id) {
 
 				//Get the parent before reset (root parent will be a negative number)
 				//Since the loop stops if node_id is below 0, it's fine
+				int const removed_id = node_id;
 				node_id = node.parent;
-				node.reset();
+				release_node(removed_id);
 
 			}
 		}
@@ -2464,7 +2654,11 @@ bool tree_add(void){
 		//We remove exactly *number_of_node_to_move* because if the node to move is empty, there is one less node available.
 		//If the node is node empty, we need to relocate it to an available node, therefore minus 1 for node_available.
 		node_available -= number_of_node_to_move;
+		//The nodes beyond *node_count* are no longer in the pool
+		rebuild_free_list();
 		for(int i = 0; i < number_of_node_to_move; ++i){
+			if(nodes()[node_count + i].available())
+				continue;
 			int const relocating_index = available_node();
 			relocate_node(node_count + i, relocating_index);
 		}
@@ -2497,8 +2691,9 @@ bool tree_delete(int const tree_id){
 	}
 	int const freed_byte = new_index_tree_base - index_last_node;
 	int const freed_node = (freed_byte - (freed_byte%sizeof(Node)))/sizeof(Node);
-	node_count += freed_node;
+	node_count = Utils::min(node_count + freed_node, static_cast<int>(Node::MAX_NODE_COUNT));
 	tree_count -= 1;
+	rebuild_free_list();
 
 	return true;
 }
@@ -2849,7 +3044,7 @@ CoarseMondrianForest(double const lifetime, double const base_measure, double co
 		int const sh = 0,
 		int const et = 0,
 		int const tt = 0,
-		double const mts = 1.0): tree_management(tm), size_type(st), size_limit(sl), dont_delete(dd), print_nodes(pn), fe_distribution(fed), fe_split_trigger(fes), tau_factor(tf), generate_full_point(fdt), reset_once(ro), fe_parameter(fep), fading_count(fc), split_helper(sh), extend_type(et), trim_type(tt), maximum_trim_size(mts) {
+		double const mts = 1.0): strategy(tm, fed, fes, sh, et, tt), size_type(st), size_limit(sl), dont_delete(dd), print_nodes(pn), tau_factor(tf), generate_full_point(fdt), reset_once(ro), fe_parameter(fep), fading_count(fc), maximum_trim_size(mts) {
 #ifdef DEBUG
 	assert(tree_count >= 1 && "Must have one tree at least");
 #endif
@@ -2861,6 +3056,8 @@ CoarseMondrianForest(double const lifetime, double const base_measure, double co
 	int const statistics_memory = tree_count * sizeof(TreeBase);
 	int const remaining_memory = max_size - statistics_memory;
 	this->node_count = (remaining_memory - (remaining_memory%sizeof(Node))) / sizeof(Node);
+	//The links between nodes cannot address more nodes than that
+	this->node_count = Utils::min(this->node_count, static_cast<int>(Node::MAX_NODE_COUNT));
 	this->node_available = node_count;
 	this->maximum_tree_count = (node_count - node_count%7)/7;
 	//Init all roots as empty
@@ -2887,6 +3084,7 @@ CoarseMondrianForest(double const lifetime, double const base_measure, double co
 			tree_bases()[i].reset(node_count);
 	for(int i = 0; i < node_count; ++i)
 		nodes()[i].reset();
+	rebuild_free_list();
 #ifdef DEBUG
 	cout << "Tree Count = " << this->tree_count << endl;
 	cout << "Node Count = " << this->node_count << endl;
@@ -2907,6 +3105,7 @@ CoarseMondrianForest(double const lifetime, double const base_measure, double co
  */
 bool train(feature_type const* features, int const label){
 	bool fully_trained = true;
+	outdate_trees();
 
 	TreeBase* base = tree_bases();
 
@@ -3290,8 +3489,39 @@ int predict(feature_type const* features, double* scores = nullptr, int tree_to_
 	//Finally, we look for the best label
 	return Utils::index_max(sum_posterior_mean, label_count);
 }
+/**
+ * Predict the labels of *count* data points.
+ * The data points are predicted by blocks of MondrianBatch::BATCH_BLOCK_SIZE: each tree predicts the whole block before the next tree, so its nodes stay in cache.
+ * With several threads, each thread predicts a contiguous range of blocks.
+ * @param features The features of the data points, one data point after the other (count * feature_count values).
+ * @param count The number of data points.
+ * @param labels An array of size *count* that will hold the predicted labels.
+ * @param scores An array of size count * label_count that will hold the average posterior means of each data point, or nullptr.
+ * @param thread_count The number of threads. With one thread, the data points are predicted by the calling thread.
+ */
+void predict_batch(feature_type const* features, int const count, int* labels, double* scores = nullptr, int thread_count = 1){
+	//Update internal count
+	#ifndef UNBOUND_OPTIMIZE
+	if(extend_type != EXTEND_GHOST)
+		update_posterior_count();
+	#endif
+	thread_count = Batch::thread_count_for(count, thread_count);
+	//The threads only read the cached posterior means, so they are all computed before
+	if(cache_posterior_means && thread_count > 1){
+		double base_posterior_means[label_count];
+		for(int l = 0; l < label_count; ++l)
+			base_posterior_means[l] = base_measure;
+		TreeBase const* bases = tree_bases();
+		for(int i = 0; i < tree_count; ++i)
+			if(!bases[i].is_empty())
+				fill_posterior_cache(bases[i].root, base_posterior_means);
+	}
+	Batch::predict(this, tree_count, features, count, labels, scores, thread_count);
+}
 
 Node* get_nodes(){
+	//The caller may change the nodes
+	outdate_trees();
 	return nodes();
 }
 TreeBase* get_bases(){
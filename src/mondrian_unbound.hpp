@@ -1,55 +1,73 @@
 #include "utils.hpp"
+#include "mondrian_batch.hpp"
 #include <vector>
+#include <thread>
 
 /**
- * MondrianForest class implements the Mondrian Forest classifier.
+ * MondrianForestUnbound class implements the Mondrian Forest classifier without any limit on the memory.
+ * Each tree allocates its nodes in its own arena, made of chunks of CHUNK_SIZE nodes that never move, and the nodes link each other with their indices in the arena.
  * Templates:
  * - feature_type: The type of the features of the data points
  * - func: a class type that contains all needed function for the Mondrian Forest.
  *   	+ exp function: A function that compute the exponential of a double. (Used to compute the posterior means)
  *   	+ rand_uniform function: A function that pick uniformly a random number between [0,1[.
  *   	+ log function: A function that run the natural logarithm.
- * - tree_count: the number of tree to use in the forest.
  * - feature_count: the number of features for one data point.
  * - label_count: the number of different labels.
- * - max_size: the maximum size of the forest in bytes
  */
 template<class feature_type, class func, int feature_count, int label_count>
 class MondrianForestUnbound{
 	//Constant to define empty values at some point in the code
 	static const int EMPTY_NODE = -1;
-	//The node structure
-	class MondrianNode {
-		protected:
+	//The node structure. Leaves and internal nodes share the same structure: a node is a leaf if its split_dimension is EMPTY_NODE.
+	struct Node{
 		//The smallest box at that node that contains all training data points who reached that node
 		double bound_lower[feature_count];
 		double bound_upper[feature_count];
-		public:
-		//Connexion between nodes.
-		//NOTE: if parent == nullptr, the node is a root
-		MondrianNode* child_left;
-		MondrianNode* child_right;
-		MondrianNode* parent;
+		//The lifetime of the node. This parameter control the growth of a tree.
 		double tau;
+		//The value used for the split
+		double split_value;
+		//Connexion between nodes, as indices in the arena of the tree.
+		//NOTE: if parent == EMPTY_NODE, the node is a root
+		int child_left, child_right, parent;
+		//The features used for the split, or EMPTY_NODE for a leaf
+		int split_dimension;
+		//For a leaf, the counters of each labels that reach that node.
+		//For an internal node, the number of children with a non-zero counter (at most 2).
+		long long int counters[label_count];
+		//The posterior means of the node, computed by the predictions. They depend on the counters, the tau, the tau of the parent
+		//and the posterior means of the parent, so they are outdated when one of them changes.
+		mutable double posterior_means[label_count];
+		//True if *posterior_means* has to be computed again
+		mutable bool cache_outdated;
 		/**
 		 * Constuctor
 		 */
-		MondrianNode(){
+		Node(){
+			cache_outdated = true;
 			for(int i = 0; i < feature_count; ++i)
 				bound_lower[i] = bound_upper[i] = 0;
-			child_left = child_right = nullptr;
-			parent = nullptr;
+			for(int i = 0; i < label_count; ++i)
+				counters[i] = posterior_means[i] = 0;
+			child_left = child_right = parent = EMPTY_NODE;
+			split_dimension = EMPTY_NODE;
+			split_value = EMPTY_NODE;
 			tau = EMPTY_NODE;
 		}
 		/**
-		 * Return true if the node is available. Return false if the node is used by one of the trees.
+		 * Return true if the node is a leaf.
 		 */
-		bool available(void) const{
-			return tau < 0;
+		bool is_leaf(void) const{
+			return split_dimension == EMPTY_NODE;
 		}
 		/**
-		 * Return true if the node is a leaf.
+		 * Return true if a data point goes to the left child of the node.
+		 * @param features The features of the data point.
 		 */
+		bool point_go_left(feature_type const* features) const{
+			return features[split_dimension] <= split_value;
+		}
 		void set_bounds(feature_type const* features){
 			//Set the box of the node node_id
 			for(int i = 0; i < feature_count; ++i){
@@ -66,44 +84,101 @@ class MondrianForestUnbound{
 					bound_upper[i] = features[i];
 			}
 		}
-		void set_tau(double const v) {
-			tau = v;
-		}
-		double get_lower_bound(int const f) const{
-			return bound_lower[f];
-		}
-		double get_upper_bound(int const f) const{
-			return bound_upper[f];
-		}
-		void set_lower_bound(int const f, double const v){
-			bound_lower[f] = v;
-		}
-		void set_upper_bound(int const f, double const v){
-			bound_upper[f] = v;
-		}
 		double compute_eta(feature_type const* features) const{
 			double eta = 0;
 			for(int i = 0; i < feature_count; ++i)
 				eta += Utils::max(features[i] - bound_upper[i], 0.0) + Utils::max(bound_lower[i] - features[i], 0.0);
 			return eta;
 		}
-	void compute_posterior_mean(double *posterior_mean, double const discount_factor) const{
+	};
+	//The number of nodes in a chunk of an arena. It is a power of two, so the index of a node splits into a chunk and an offset with a shift and a mask.
+	static int const CHUNK_SIZE = 256;
+	/**
+	 * The nodes of a tree. A tree never frees its nodes, so a new node is always added at the end of the last chunk,
+	 * and a new chunk is allocated when the last one is full. The chunks are never reallocated, so the references to the nodes stay valid.
+	 */
+	class Arena{
+		vector<vector<Node>> chunks;
+		int size = 0;
+		public:
+		/**
+		 * Add a new node at the end of the arena and return its index.
+		 */
+		int new_node(void){
+			if(size % CHUNK_SIZE == 0){
+				chunks.push_back(vector<Node>());
+				chunks.back().reserve(CHUNK_SIZE);
+			}
+			chunks.back().push_back(Node());
+			size += 1;
+			return size - 1;
+		}
+		Node& operator[](int const node_id){
+			return chunks[node_id / CHUNK_SIZE][node_id % CHUNK_SIZE];
+		}
+		Node const& operator[](int const node_id) const{
+			return chunks[node_id / CHUNK_SIZE][node_id % CHUNK_SIZE];
+		}
+	};
+	//The batch predictions call *predict_tree*
+	typedef MondrianBatch<feature_type, feature_count, label_count> Batch;
+	friend class MondrianBatch<feature_type, feature_count, label_count>;
+	//The arena of each tree
+	vector<Arena> arenas;
+	//The node_id of the roots of each tree
+	vector<int> roots;
+	//The random generator of each tree used by *train_batch*. It keeps its state between two batches.
+	vector<XorShiftRandom> generators;
+	//The lifetime parameter
+	double lifetime;
+	//The base measure parameter
+	double base_measure;
+	//The discount factor parameter
+	double discount_factor;
+	int tree_count;
+	long long int count_data_point = 0;
+
+	/**
+	 * Update the counter of a label in the ancestors of a node.
+	 * An internal node only depends on whether the counters of its children are zero, so the update stops at the first ancestor that does not change.
+	 * @param nodes The arena of the tree.
+	 * @param node_id The index of the node.
+	 * @param label The label to update.
+	 */
+	static void update_parent_counters(Arena& nodes, int const node_id, int const label){
+		for(int parent_id = nodes[node_id].parent; parent_id != EMPTY_NODE; parent_id = nodes[parent_id].parent){
+			Node& parent = nodes[parent_id];
+			long long int const count = Utils::min(static_cast<long long int>(1), nodes[parent.child_left].counters[label])
+				+ Utils::min(static_cast<long long int>(1), nodes[parent.child_right].counters[label]);
+			if(count == parent.counters[label])
+				return;
+			parent.counters[label] = count;
+			parent.cache_outdated = true;
+		}
+	}
+	/**
+	 * Compute the posterior mean at a node based on the posterior mean of its parent.
+	 * @param nodes The arena of the tree.
+	 * @param node The node.
+	 * @param posterior_mean The posterior mean of the parent. It will be turned into the posterior mean of the node.
+	 */
+	void compute_posterior_mean(Arena const& nodes, Node const& node, double *posterior_mean) const{
 		//posterior_mean start with the parent posterior_mean and the function updates to the current node
-		double const parent_tau = this->parent != nullptr ? this->parent->tau : 0; //The tau value of the parent of the root is 0
-		double const node_discount = func::exp(discount_factor * (this->tau - parent_tau));
+		double const parent_tau = node.parent != EMPTY_NODE ? nodes[node.parent].tau : 0; //The tau value of the parent of the root is 0
+		double const node_discount = func::exp(discount_factor * (node.tau - parent_tau));
 		double sum_counters = 0;
 		double sum_tab = 0;
 		double tab[label_count];
 		//Compute sum_counters and sum_tab, and set tab
 		for(int i = 0; i < label_count; ++i){
-			double ci = static_cast<double>(this->get_counters(i));
+			double ci = static_cast<double>(node.counters[i]);
 			sum_counters += ci;
 			tab[i] = Utils::min(ci, static_cast<double>(1));
 			sum_tab += tab[i];
 		}
 		//For each label with a counter higher than zero, compute the posterior mean. Otherwise it is simply the posterior mean of the parent
 		for(int i = 0; i < label_count; ++i){
-			long long int ci = this->get_counters(i);
+			long long int ci = node.counters[i];
 			if(ci > 0){
 				double const c = static_cast<double>(ci);
 				double const a = c - node_discount * tab[i];
@@ -112,242 +187,131 @@ class MondrianForestUnbound{
 			}
 		}
 	}
-		virtual void update_counters(int const label, long long int const qty)=0;
-		virtual void update_counters(void)=0;
-		virtual long long int get_counters(int const label) const=0;
-		virtual bool is_leaf(void) const =0;
-		virtual ~MondrianNode(){
-			delete child_left;
-			delete child_right;
-		}
-	};
-	class LeafNode : public MondrianNode{
-		//The counters of each labels that reach that node.
-		long long int counters[label_count];
-		public:
-		virtual bool is_leaf(void) const{
-			return true;
-		}
-		/**
-		 * Constuctor
-		 */
-		LeafNode(){
-			for(int i = 0; i < label_count; ++i)
-				counters[i] = 0;
-		}
-		virtual void update_counters(int const label, long long int const qty){
-			counters[label] += qty;
-			if (this->parent != nullptr)
-				this->parent->update_counters(label, qty);
-		}
-		virtual void update_counters(void){
-			if (this->parent != nullptr)
-				this->parent->update_counters();
-		}
-		virtual long long int get_counters(int const label) const{
-			return counters[label];
-		}
-	};
-	class InternalNode : public MondrianNode{
-		//The features used for the split
-		int split_dimension;
-		//The value used for the split
-		double split_value;
-		//The counters of each labels that reach that node. At most equal to 2
-		char counters[label_count];
-		public:
-		InternalNode(){
-			for(int i = 0; i < label_count; ++i)
-				counters[i] = 0;
-			split_dimension = EMPTY_NODE;
-			split_value = EMPTY_NODE;
-		}
-		void set_split_dimension(int const sd){
-			split_dimension = sd;
-		}
-		void set_split_value(double const sv){
-			split_value = sv;
-		}
-		int get_split_dimension(void) const{
-			return split_dimension;
-		}
-		double get_split_value(void) const{
-			return split_value;
-		}
-		bool point_go_left(feature_type const* features) const{
-			return features[split_dimension] <= split_value;
-		}
-		virtual bool is_leaf(void) const{
-			return false;
-		}
-		virtual void update_counters(int const label, long long int const qty){
-			//if(counters[label] == 2)
-				//return;
-			long long int l = Utils::min(static_cast<long long int>(1), this->child_left->get_counters(label));
-			long long int r = Utils::min(static_cast<long long int>(1), this->child_right->get_counters(label));
-			char cleft = (char) l;
-			char cright = (char) r;
-			counters[label] = cleft+cright;
-			if(this->parent != nullptr)
-				this->parent->update_counters(label, qty);
-		}
-		virtual void update_counters(void){
-			for(int label = 0; label < label_count; ++label){
-				long long int l = Utils::min(static_cast<long long int>(1), this->child_left->get_counters(label));
-				long long int r = Utils::min(static_cast<long long int>(1), this->child_right->get_counters(label));
-				char cleft = (char) l;
-				char cright = (char) r;
-				counters[label] = cleft+cright;
-			}
-			if (this->parent != nullptr)
-				this->parent->update_counters();
-		}
-		virtual long long int get_counters(int const label) const{
-			return (long long int) counters[label];
-		}
-	};
-	//The node_id of the roots of each tree
-	vector<MondrianNode*> roots;
-	//The lifetime parameter
-	double lifetime;
-	//The base measure parameter
-	double base_measure;
-	//The discount factor parameter
-	double discount_factor;
-	int tree_count;
-	long long int count_internal_nodes = 0;
-	long long int count_leaf_nodes = 0;
-	long long int count_data_point = 0;
-
 	/**
 	 * Given a node, apply the extend algorithm described in the Mondrian paper.
-	 * @param node_id The index of the node in the array *nodes*.
-	 * @param tree_id The id of the tree the node belongs. This is used to check if the node is the root or not.
+	 * @param node_id The index of the node in the arena of the tree.
+	 * @param tree_id The id of the tree the node belongs.
 	 * @param features The features of the new data point.
 	 * @param label The label of the new data  point.
+	 * @param generator The random generator.
 	 */
-	void extend_block(MondrianNode* node, int const tree_id, feature_type const* features, int const label){
+	template<class random>
+	void extend_block(int const node_id, int const tree_id, feature_type const* features, int const label, random& generator){
+		Arena& nodes = arenas[tree_id];
+		Node& node = nodes[node_id];
 		//e_lower and e_upper are used to compute probabilities
 		feature_type e_lower[feature_count], e_upper[feature_count];
 		double probabilities[feature_count];
-		MondrianNode* parent = node->parent;
-		double const parent_tau = parent != nullptr ? parent->tau : 0; //The tau value of the parent of the root is 0
+		int const parent_id = node.parent;
+		double const parent_tau = parent_id != EMPTY_NODE ? nodes[parent_id].tau : 0; //The tau value of the parent of the root is 0
 		//sum is used as a parameter to pick random numbers following exponential law
 		feature_type sum = 0;
 		//compute e_lower, e_upper and sum
 		for(int i = 0; i < feature_count; ++i){
-			e_lower[i] = node->get_lower_bound(i) - features[i] > 0 ? node->get_lower_bound(i) - features[i] : 0;
-			e_upper[i] = features[i] - node->get_upper_bound(i) > 0 ? features[i] - node->get_upper_bound(i) : 0;
+			e_lower[i] = node.bound_lower[i] - features[i] > 0 ? node.bound_lower[i] - features[i] : 0;
+			e_upper[i] = features[i] - node.bound_upper[i] > 0 ? features[i] - node.bound_upper[i] : 0;
 			probabilities[i] = e_lower[i] + e_upper[i];
 			sum += e_lower[i] + e_upper[i];
 		}
 		//Pick a random number following an exponential law of parameter *sum* (except if sum is 0)
-		double const E = sum == 0 ?  -1 : Utils::rand_exponential<func>(sum);
-		bool update_box = false;
-		if(E >= 0 && parent_tau + E < node->tau){//Introduce a new parent and a new sibling
+		double const E = sum == 0 ?  -1 : Utils::rand_exponential<func>(sum, generator);
+		if(E >= 0 && parent_tau + E < node.tau){//Introduce a new parent and a new sibling
 			Utils::turn_array_into_probability(probabilities, feature_count, sum);
 			//sample features with probability proportional to e_lower[i] + e_upper[i]
-			int const dimension = Utils::pick_from_distribution<func>(probabilities, feature_count);
+			int dimension = Utils::pick_from_distribution(probabilities, feature_count, generator);
+			if(dimension >= feature_count || dimension < 0){
+				dimension = static_cast<int>(generator.rand_uniform() * static_cast<double>(feature_count));
+			}
 
 			//Select the bound to choose the split from
 			double lower_value, upper_value;
-			if(features[dimension] > node->get_upper_bound(dimension)){
-				lower_value = node->get_upper_bound(dimension);
+			if(features[dimension] > node.bound_upper[dimension]){
+				lower_value = node.bound_upper[dimension];
 				upper_value = features[dimension];
 			}
-			else if(features[dimension] < node->get_lower_bound(dimension)){
+			else if(features[dimension] < node.bound_lower[dimension]){
 				lower_value = features[dimension];
-				upper_value = node->get_lower_bound(dimension);
+				upper_value = node.bound_lower[dimension];
 			}
 
 			//sample the split between [lower_value, upper_value]
-			double const split_value = func::rand_uniform()*(upper_value - lower_value) + lower_value;
-			InternalNode* new_parent = new InternalNode();
-			LeafNode* new_sibling = new LeafNode();
-			count_internal_nodes += 1;
-			count_leaf_nodes += 1;
-			//insert new node above the current one
-			new_parent->set_split_dimension(dimension);
-			new_parent->set_split_value(split_value);
-			new_parent->tau = parent_tau + E;
-
-			//insert new leaf, sibbling of the current one
+			double const split_value = generator.rand_uniform()*(upper_value - lower_value) + lower_value;
+			//insert new node above the current one, and a new leaf, sibbling of the current one
+			int const new_parent_id = nodes.new_node();
+			int const new_sibling_id = nodes.new_node();
+			Node& new_parent = nodes[new_parent_id];
+			new_parent.split_dimension = dimension;
+			new_parent.split_value = split_value;
+			new_parent.tau = parent_tau + E;
 
 			//Update the box of the new parent
 			for(int i = 0; i < feature_count; ++i){
-				new_parent->set_lower_bound(i, features[i] < node->get_lower_bound(i) ? features[i] : node->get_lower_bound(i));
-				new_parent->set_upper_bound(i, features[i] > node->get_upper_bound(i) ? features[i] : node->get_upper_bound(i));
+				new_parent.bound_lower[i] = features[i] < node.bound_lower[i] ? features[i] : node.bound_lower[i];
+				new_parent.bound_upper[i] = features[i] > node.bound_upper[i] ? features[i] : node.bound_upper[i];
 			}
-			//NOTE Creates counters for the label of the new parent
 			//No need to increase the counter for the current label because we will call sample_block soon on new_sibling
 
 			//Make the connections between the new nodes
-			new_parent->parent = node->parent;
-			if(node->parent == nullptr && node == roots[tree_id])//We introduce a parent to the root
-				roots[tree_id] = new_parent;
+			new_parent.parent = parent_id;
+			if(parent_id == EMPTY_NODE)//We introduce a parent to the root
+				roots[tree_id] = new_parent_id;
 			else{
-				MondrianNode* parent = node->parent;
-				if(parent->child_left == node)
-					parent->child_left = new_parent;
+				Node& parent = nodes[parent_id];
+				if(parent.child_left == node_id)
+					parent.child_left = new_parent_id;
 				else
-					parent->child_right = new_parent;
+					parent.child_right = new_parent_id;
 			}
 
+			node.parent = new_parent_id;
+			node.cache_outdated = true;
 
-			node->parent = new_parent;
-
-			new_sibling->parent = new_parent;
+			nodes[new_sibling_id].parent = new_parent_id;
 			if(features[dimension] == upper_value){ //right
-				new_parent->child_right = new_sibling;
-				new_parent->child_left = node;
+				new_parent.child_right = new_sibling_id;
+				new_parent.child_left = node_id;
 			}
 			else{ //left
-				new_parent->child_left = new_sibling;
-				new_parent->child_right = node;
+				new_parent.child_left = new_sibling_id;
+				new_parent.child_right = node_id;
 			}
 
-			//cout << "Split dimension " << dimension << " on " << split_value << "(data point: " << count_data_point << endl;
-			sample_block(new_sibling, features, label);
-			new_parent->update_counters();
-
-		}
-		else{
-			update_box = true;
+			sample_block(tree_id, new_sibling_id, features, label);
+			//The new parent and its ancestors count the labels of the current node as well
+			for(int l = 0; l < label_count; ++l)
+				update_parent_counters(nodes, new_sibling_id, l);
 		}
-
-		if(update_box){ //Otherwise, just update the box
-			node->update_box(features);
+		else{ //Otherwise, just update the box
+			node.update_box(features);
 			//if not leaf, recurse on the node that contains the data point
-			if(!node->is_leaf()){
-				InternalNode* inode = dynamic_cast<InternalNode *>(node);
-				if(inode->point_go_left(features))
-					extend_block(inode->child_left, tree_id, features, label);
-				else
-					extend_block(inode->child_right, tree_id, features, label);
-				//NOTE: we don't update the counters of labels here because the counting will be done when prediction is required.
-				//We can optimize that.
+			if(!node.is_leaf()){
+				extend_block(node.point_go_left(features) ? node.child_left : node.child_right, tree_id, features, label, generator);
 			}
 			else{
-				LeafNode* lnode = dynamic_cast<LeafNode *>(node);
 				//Update the counter of label
-				lnode->update_counters(label, 1);
-
+				node.counters[label] += 1;
+				node.cache_outdated = true;
+				update_parent_counters(nodes, node_id, label);
 			}
 		}
 	}
 	/**
-	 * Given a node, apply the sample algorithm described in the Mondrian paper..
-	 * @param node_id The index of the node in the array *nodes*.
+	 * Given a leaf, apply the sample algorithm described in the Mondrian paper..
+	 * @param tree_id The id of the tree the node belongs.
+	 * @param node_id The index of the leaf in the arena of the tree.
 	 * @param features The features of the new data point.
 	 * @param label The label of the new data  point.
 	 */
-	void sample_block(LeafNode* node, feature_type const* features, int const label){
-		node->set_bounds(features);
+	void sample_block(int const tree_id, int const node_id, feature_type const* features, int const label){
+		Arena& nodes = arenas[tree_id];
+		nodes[node_id].set_bounds(features);
 		//Update the counter for labels
-		node->update_counters(label, 1);
+		nodes[node_id].counters[label] += 1;
+		nodes[node_id].cache_outdated = true;
+		update_parent_counters(nodes, node_id, label);
 		//NOTE we don't need to check for lifetime because we only have one element
 		//see the original source code (https://github.com/balajiln/mondrianforest)
-		node->set_tau(lifetime);
+		nodes[node_id].tau = lifetime;
 	}
 	/**
 	 * Train tree *tree_id* with a new data point. If the tree does not exist, it will be created.
@@ -355,20 +319,20 @@ class MondrianForestUnbound{
 	 * @param features The features of the new data point.
 	 * @param label The label of the new data  point.
 	 * @param tree_id The id of the tree which is an index between 0 and tree_count.
+	 * @param generator The random generator.
 	 */
-	bool train_tree(feature_type const* features, int const label, int const tree_id){
-		MondrianNode* root = roots[tree_id];
-		if (root == nullptr){ //The root of the tree does not exist yet
+	template<class random>
+	bool train_tree(feature_type const* features, int const label, int const tree_id, random& generator){
+		int const root_id = roots[tree_id];
+		if (root_id == EMPTY_NODE){ //The root of the tree does not exist yet
 			//Initialize this node as the root for this tree
-			LeafNode* leafroot = new LeafNode();
-			roots[tree_id] = leafroot;
-			count_leaf_nodes += 1;
+			roots[tree_id] = arenas[tree_id].new_node();
 
 			//Sample the root with the new data point
-			sample_block(leafroot, features, label);
+			sample_block(tree_id, roots[tree_id], features, label);
 		}
 		else{ //Partial fit
-			extend_block(root, tree_id, features, label);
+			extend_block(root_id, tree_id, features, label, generator);
 		}
 		return true;
 	}
@@ -381,11 +345,14 @@ class MondrianForestUnbound{
 	 * @param posterior_mean An array in the size of label_count, that will hold the posterior means.
 	 */
 	void predict_tree(feature_type const* features, int const tree_id, double* posterior_means) const{
-		MondrianNode* current_node = roots[tree_id];
+		Arena const& nodes = arenas[tree_id];
+		int node_id = roots[tree_id];
+		//The posterior means of the parent of the root are the base measure
+		double base_posterior_means[label_count];
 		for(int i = 0; i < label_count; ++i)
-			posterior_means[i] = base_measure;
+			posterior_means[i] = base_posterior_means[i] = base_measure;
+		double const* parent_posterior_means = base_posterior_means;
 
-		double pp_sum = 0, pp_mul = 1;
 		double probability_of_branching;
 		double probability_not_separated_yet = 1;
 		double parent_tau = 0;
@@ -393,9 +360,10 @@ class MondrianForestUnbound{
 		double smoothed_posterior_means[label_count] = {0};
 
 		//Find the corresponding leaf for the data point
-		while(current_node != nullptr) {
-			double const delta_tau = current_node->tau - parent_tau;
-			double const eta = current_node->compute_eta(features);
+		while(node_id != EMPTY_NODE) {
+			Node const& current_node = nodes[node_id];
+			double const delta_tau = current_node.tau - parent_tau;
+			double const eta = current_node.compute_eta(features);
 			probability_of_branching = 1 - func::exp(-delta_tau * eta);
 
 			if(probability_of_branching > 0){
@@ -405,37 +373,95 @@ class MondrianForestUnbound{
 				double c_sum = 0;
 				//We need the sum of *c*, so we need two loops
 				for(int l = 0; l < label_count; ++l){
-					c[l] = Utils::min(static_cast<double>(current_node->get_counters(l)), static_cast<double>(1));
+					c[l] = Utils::min(static_cast<double>(current_node.counters[l]), static_cast<double>(1));
 					c_sum += c[l];
 				}
 
 				for(int l = 0; l < label_count; ++l){
 					//posterior_means of the parent of current_node
-					double const posterior_mean = (1/c_sum) * (c[l] - new_node_discount * c[l] + c_sum * posterior_means[l]);
+					double const posterior_mean = (1/c_sum) * (c[l] - new_node_discount * c[l] + c_sum * parent_posterior_means[l]);
 					//Note that *posterior_mean* is the value for the hypothetical parent
 					smoothed_posterior_means[l] += probability_not_separated_yet * probability_of_branching * posterior_mean;
 				}
 			}
 
-			//NOTE: *posterior_means* cannot be update before we need the parent value above
-			current_node->compute_posterior_mean(posterior_means, discount_factor);
+			double const* node_posterior_means = cached_posterior_means(nodes, current_node, parent_posterior_means);
 
 			//If we reach a leaf, and *posterior_means* will be set to the value for this leaf.
-			if(current_node->is_leaf()){
+			if(current_node.is_leaf()){
 				for(int l = 0; l < label_count; ++l)
-					posterior_means[l] = smoothed_posterior_means[l] + probability_not_separated_yet * (1 - probability_of_branching) * posterior_means[l];
+					posterior_means[l] = smoothed_posterior_means[l] + probability_not_separated_yet * (1 - probability_of_branching) * node_posterior_means[l];
 				break;
 			}
-			InternalNode* inode = dynamic_cast<InternalNode*>(current_node);
 			probability_not_separated_yet *= (1 - probability_of_branching);
+			parent_posterior_means = node_posterior_means;
 
 			//Otherwise, the child is picked based on the split of the node
-			if(inode->point_go_left(features))
-				current_node = inode->child_left;
-			else
-				current_node = inode->child_right;
+			node_id = current_node.point_go_left(features) ? current_node.child_left : current_node.child_right;
+		}
+	}
+	/**
+	 * Return the posterior means of a node. They only depend on the node and its ancestors, so they are cached in the node until the node is outdated.
+	 * A node whose posterior means change outdates its children.
+	 * @param nodes The arena of the tree.
+	 * @param node The node.
+	 * @param parent_posterior_means The posterior means of the parent of the node.
+	 */
+	double const* cached_posterior_means(Arena const& nodes, Node const& node, double const* parent_posterior_means) const{
+		if(node.cache_outdated){
+			double posterior_means[label_count];
+			for(int l = 0; l < label_count; ++l)
+				posterior_means[l] = parent_posterior_means[l];
+			compute_posterior_mean(nodes, node, posterior_means);
+			//The children only need to be computed again if the posterior means have changed
+			bool changed = false;
+			for(int l = 0; l < label_count; ++l){
+				if(node.posterior_means[l] != posterior_means[l]){
+					node.posterior_means[l] = posterior_means[l];
+					changed = true;
+				}
+			}
+			if(changed && !node.is_leaf()){
+				nodes[node.child_left].cache_outdated = true;
+				nodes[node.child_right].cache_outdated = true;
+			}
+			node.cache_outdated = false;
+		}
+		return node.posterior_means;
+	}
+	/**
+	 * Compute the posterior means of a node and all its descendants, so the predictions only read the cache.
+	 * It is a recursive function so if apply to the root, it will apply to an entire tree.
+	 * @param nodes The arena of the tree.
+	 * @param node_id The index of the node in the arena of the tree.
+	 * @param parent_posterior_means The posterior means of the parent of the node.
+	 */
+	void fill_posterior_cache(Arena const& nodes, int const node_id, double const* parent_posterior_means) const{
+		Node const& node = nodes[node_id];
+		double const* node_posterior_means = cached_posterior_means(nodes, node, parent_posterior_means);
+		if(!node.is_leaf()){
+			fill_posterior_cache(nodes, node.child_left, node_posterior_means);
+			fill_posterior_cache(nodes, node.child_right, node_posterior_means);
 		}
 	}
+	/**
+	 * Train the trees from *first* to *last* excluded with all the data points of a batch. This is the work of one thread of *train_batch*.
+	 * @param features The features of the data points.
+	 * @param labels The labels of the data points.
+	 * @param count The number of data points.
+	 * @param first The first tree to train.
+	 * @param last The tree after the last tree to train.
+	 * @param trained An array of size tree_count set to 1 for each tree that has been fully trained.
+	 */
+	void train_trees(feature_type const* features, int const* labels, int const count, int const first, int const last, char* trained){
+		//Like *train*, each data point goes through all the trees before the next one
+		for(int tree_id = first; tree_id < last; ++tree_id)
+			trained[tree_id] = 1;
+		for(int i = 0; i < count; ++i)
+			for(int tree_id = first; tree_id < last; ++tree_id)
+				if(!train_tree(features + i * feature_count, labels[i], tree_id, generators[tree_id]))
+					trained[tree_id] = 0;
+	}
 	public:
 	/**
 	 * Constructor.
@@ -449,7 +475,18 @@ class MondrianForestUnbound{
 		this->discount_factor = discount_factor;
 		this->tree_count = tree_count;
 		//Init all roots as empty
-		roots.resize(tree_count, nullptr);
+		roots.resize(tree_count, static_cast<int>(EMPTY_NODE));
+		arenas.resize(tree_count);
+		generators.resize(tree_count);
+		set_seed(0);
+	}
+	/**
+	 * Seed the random generators used by *train_batch*. The generator of the tree *tree_id* starts from the seed seed * tree_count + tree_id.
+	 * @param seed The seed of the random generators.
+	 */
+	void set_seed(uint64_t const seed){
+		for(int tree_id = 0; tree_id < tree_count; ++tree_id)
+			generators[tree_id] = XorShiftRandom(seed * tree_count + tree_id);
 	}
 	/**
 	 * Train all trees of the forest with a new data point.
@@ -458,15 +495,46 @@ class MondrianForestUnbound{
 	 * @param label The label of the data point.
 	 */
 	bool train(feature_type const* features, int const label){
-		bool fully_trained;
+		FuncRandom<func> generator;
+		bool fully_trained = true;
 		for(int i = 0; i < tree_count; ++i){
-			bool has_trained = train_tree(features, label, i);
+			bool has_trained = train_tree(features, label, i, generator);
 			if(!has_trained)
 				fully_trained = false;
 		}
 		count_data_point += 1;
 		return fully_trained;
 	}
+	/**
+	 * Train all trees of the forest with *count* data points, with the trees split between *thread_count* threads.
+	 * Each thread trains its own trees with all the data points, in order.
+	 * The random numbers come from one XorShiftRandom per tree instead of *func::rand_uniform*, so the trees do not depend on the number of threads.
+	 * The generators are seeded by *set_seed* and go on from one batch to the next, so training two batches is the same as training them in one batch.
+	 * Return false if a tree has failed to be trained.
+	 * @param features The features of the data points, one data point after the other (count * feature_count values).
+	 * @param labels The labels of the data points.
+	 * @param count The number of data points.
+	 * @param thread_count The number of threads. With one thread, the trees are trained by the calling thread.
+	 */
+	bool train_batch(feature_type const* features, int const* labels, int const count, int thread_count = 1){
+		if(thread_count > tree_count)
+			thread_count = tree_count;
+		if(thread_count < 1)
+			thread_count = 1;
+		vector<char> trained(tree_count, 0);
+		vector<std::thread> threads;
+		for(int t = 1; t < thread_count; ++t)
+			threads.push_back(std::thread(&MondrianForestUnbound::train_trees, this, features, labels, count, t * tree_count / thread_count, (t + 1) * tree_count / thread_count, trained.data()));
+		train_trees(features, labels, count, 0, tree_count / thread_count, trained.data());
+		for(std::thread& thread : threads)
+			thread.join();
+		count_data_point += count;
+		bool fully_trained = true;
+		for(int i = 0; i < tree_count; ++i)
+			if(!trained[i])
+				fully_trained = false;
+		return fully_trained;
+	}
 	/**
 	 * Predict the label of the data point.
 	 * Return the most likely label.
@@ -496,10 +564,28 @@ class MondrianForestUnbound{
 		}
 		return best;
 	}
-	~MondrianForestUnbound(){
-		for(MondrianNode* root : roots)
-			if(root != nullptr)
-				delete root;
+	/**
+	 * Predict the labels of *count* data points.
+	 * The data points are predicted by blocks of MondrianBatch::BATCH_BLOCK_SIZE: each tree predicts the whole block before the next tree, so its nodes stay in cache.
+	 * With several threads, each thread predicts a contiguous range of blocks.
+	 * @param features The features of the data points, one data point after the other (count * feature_count values).
+	 * @param count The number of data points.
+	 * @param labels An array of size *count* that will hold the predicted labels.
+	 * @param scores An array of size count * label_count that will hold the average posterior means of each data point, or nullptr.
+	 * @param thread_count The number of threads. With one thread, the data points are predicted by the calling thread.
+	 */
+	void predict_batch(feature_type const* features, int const count, int* labels, double* scores = nullptr, int thread_count = 1){
+		thread_count = Batch::thread_count_for(count, thread_count);
+		//The threads only read the cached posterior means, so they are all computed before
+		if(thread_count > 1){
+			double base_posterior_means[label_count];
+			for(int l = 0; l < label_count; ++l)
+				base_posterior_means[l] = base_measure;
+			for(int i = 0; i < tree_count; ++i)
+				if(roots[i] != EMPTY_NODE)
+					fill_posterior_cache(arenas[i], roots[i], base_posterior_means);
+		}
+		Batch::predict(this, tree_count, features, count, labels, scores, thread_count);
 	}
 };
 
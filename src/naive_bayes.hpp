@@ -1,73 +1,143 @@
+#include <limits>
+#include "gaussian_estimator.hpp"
+/**
+ * The models available for the features of NaiveBayes.
+ * - GAUSSIAN: the feature is numeric and follows a normal distribution per label.
+ * - CATEGORICAL: the feature is a code between 0 and the number of values of the feature, with one probability per value and per label.
+ * - MULTINOMIAL: the feature counts occurrences of an event, the events of all multinomial features are drawn from one distribution per label.
+ */
+class NaiveBayesModel{
+	public:
+	static int const GAUSSIAN = 0;
+	static int const CATEGORICAL = 1;
+	static int const MULTINOMIAL = 2;
+};
+/**
+ * The feature policies tell NaiveBayes how to model each feature. A feature policy provides:
+ * - value_count: the maximum number of values of the categorical features, which is the size of the value dimension of the count tables.
+ * - model(feature): the model of the feature, one of the constants of NaiveBayesModel.
+ * A policy may mix models, for instance by returning a different model depending on the feature.
+ */
+
+/**
+ * Policy that models all features with normal distributions.
+ */
+class GaussianFeatures{
+	public:
+	static int const value_count = 1;
+	static int model(int const){
+		return NaiveBayesModel::GAUSSIAN;
+	}
+};
+/**
+ * Policy that models all features as categorical.
+ * Templates:
+ * - values: the maximum number of values of a feature.
+ */
+template<int values>
+class CategoricalFeatures{
+	public:
+	static int const value_count = values;
+	static int model(int const){
+		return NaiveBayesModel::CATEGORICAL;
+	}
+};
+/**
+ * Policy that models all features as multinomial.
+ */
+class MultinomialFeatures{
+	public:
+	static int const value_count = 1;
+	static int model(int const){
+		return NaiveBayesModel::MULTINOMIAL;
+	}
+};
+
 /**
  * NaiveBayes class implements the Naive Bayes classifier.
  * Templates:
- * - feature_type: the type to use for the feature. Either double or float since we are working with numeric attribute only.
+ * - feature_type: the type to use for the feature.
  * - label_count: How many labels/classes/categories must be expected.
  * - feature_count: the number of features for one data point.
  * - funct: a class type that contains all needed function for the Naive Bayes.
  *   	+ log function: a logarithmic function (log2, log10, ln, ...) to avoid underflow.
  *   	+ sqrt function: a square root function.
+ * - features_model: the feature policy that selects the model of each feature (default: GaussianFeatures).
  */
-template<class feature_type, int label_count, int feature_count, class func>
+template<class feature_type, int label_count, int feature_count, class func, class features_model = GaussianFeatures>
 class NaiveBayes{
-	class GaussianEstimator{
-		double weight_sum = 0, variance_sum = 0, mean = 0;
-		public:
-		void train(double const value, double const weight){
-			if (weight_sum > 0.0) {
-				weight_sum += weight;
-				double const previous_mean = mean;
-				mean += weight * (value - previous_mean) / weight_sum; 
-				variance_sum += weight * (value - previous_mean) * (value - mean);
-			} 
-			else {
-				mean = value;
-				weight_sum = weight;
-				variance_sum = 0;
-			}
-		}
-		double probability_density(double const value) const{
-			if(weight_sum <= 0)
-				return 0.0;
-			double const variance = (weight_sum > 1.0) ? (variance_sum / (weight_sum - 1.0)) : 0.0;
-			double const stdev = func::sqrt(variance);
-			if(stdev > 0){
-				double const diff = value - mean;
-				double const NORMAL_CONSTANT = 2.50663; //square root of 2*M_PI
-				return (1.0 / (NORMAL_CONSTANT * stdev)) * exp(-(diff * diff / (2.0 * stdev * stdev)));
-			}
-			return (value == mean) ? 1.0 : 0.0;
-		}
-	};
-	//The sum of the value in features_size
-	int sum_feature_size = 0;
+	static int const value_count = features_model::value_count;
+	//The number of values of each categorical feature
+	int features_size[feature_count];
 	//The list of estimators for each feature and each label.
-	GaussianEstimator counters[label_count * feature_count];
+	GaussianEstimator<func> counters[label_count * feature_count];
+	//The counts of the discrete features: a categorical feature counts each of its values, a multinomial feature counts its events in the value 0.
+	//They are weighted like the Gaussian estimators and the label weights, so they are not integers in general.
+	double counts[label_count][feature_count][value_count];
 	double label_weights[label_count] = {0};
 	double total_weights = 0;
-	//The smoothing value
+	//The smoothing value, added to every count of the discrete features (Laplace smoothing)
 	double smoothing;
+	/*
+	 * The log-likelihood of a feature value *x* given a label is bias - (x - mean)^2 * precision.
+	 * The means and the precisions are cached per feature then per label, so the scores of all labels are updated together,
+	 * and the bias of a label is the sum of its constant terms with the log of the label weight.
+	 * They are computed again, before a prediction, for the labels trained since the previous prediction.
+	 */
+	double means[feature_count][label_count];
+	double precisions[feature_count][label_count];
+	//The log-probability of each value of the discrete features, cached per feature, per value then per label like the means
+	double log_probabilities[feature_count][value_count][label_count];
+	double biases[label_count];
+	double log_total_weights = 0;
+	bool stale[label_count];
+	bool stale_total = true;
 
 	public:
+		/*
+		* Constructor. The categorical features can take *value_count* values.
+		* @param smoothing the smoothing value to use.
+		*/
+		NaiveBayes(double const smoothing=1.0){
+			int sizes[feature_count];
+			for(int f = 0; f < feature_count; ++f)
+				sizes[f] = value_count;
+			init(sizes, smoothing);
+		}
 		/*
 		* Constructor.
+		* @param features_size an array of size *feature_count* that contain how many value there is for each categorical feature (at most *value_count*).
 		* @param smoothing the smoothing value to use.
 		*/
-		NaiveBayes(double const smoothing=0.0){
-			//Set the smoothing
-			this->smoothing = smoothing;
+		NaiveBayes(int const* features_size, double const smoothing=1.0){
+			init(features_size, smoothing);
 		}
 		/*
 		* Train the model with one data point.
-		* @param features an array of size *feature_count* that contain how many value there is for each feature.
-		* @param smoothing the smoothing value to use.
+		* @param features an array of size *feature_count* that contain the value of each feature.
+		* @param label the label of the data point.
 		* @param weight the weight to give to this data point (default: 1.0).
 		*/
 		bool train(feature_type const* features, int const label, double const weight = 1.0){
-			for(int i = 0; i < feature_count; ++i)
-				counters[label * feature_count + i].train(features[i], weight);
+			for(int f = 0; f < feature_count; ++f){
+				int const model = features_model::model(f);
+				if(model == NaiveBayesModel::GAUSSIAN){
+					counters[label * feature_count + f].train(features[f], weight);
+				}
+				else if(model == NaiveBayesModel::CATEGORICAL){
+					int const value = static_cast<int>(features[f]);
+					//The values that do not fit in the table are ignored
+					if(value >= 0 && value < features_size[f])
+						counts[label][f][value] += weight;
+				}
+				else{
+					counts[label][f][0] += static_cast<int>(features[f]) * weight;
+				}
+			}
 			label_weights[label] += weight;
 			total_weights += weight;
+			stale[label] = true;
+			stale_total = true;
 			return true;
 		}
 		/*
@@ -75,25 +145,25 @@ class NaiveBayes{
 		* @param features an array of size *feature_count* that contains the value of the data point.
 		* @param scores a pointer of size *label_count* that will store the score for each label.
 		*/
-		int predict(feature_type* features, double* scores = nullptr){
-			double local_score[label_count] = {0};	
-			//Accumulate the probability for each label
-			for(int l = 0; l < label_count; ++l){
-				local_score[l] = func::log(label_weights[l] / total_weights);
-				for(int f = 0; f < feature_count; ++f)//Add the log to avoid overflow
-					local_score[l] += func::log(counters[l * feature_count + f].probability_density(features[f]));
-			}
-
-			int max_l = 0;
-			for(int l = 1; l < label_count; ++l){
-				if(local_score[max_l] < local_score[l])
-					max_l = l;
-			}
-			if(scores != nullptr){
-				for(int l = 0; l < label_count; ++l)
-					scores[l] = local_score[l];
+		int predict(feature_type const* features, double* scores = nullptr){
+			refresh_cache();
+			double local_score[label_count];
+			return compute_scores(features, (scores != nullptr ? scores : local_score));
+		}
+		/*
+		* Predict the labels of several data points.
+		* @param features an array of size *count* x *feature_count* that contains the values of the data points, one data point after the other.
+		* @param count the number of data points.
+		* @param labels an array of size *count* that will store the predicted labels.
+		* @param scores a pointer of size *count* x *label_count* that will store the score for each label of each data point.
+		*/
+		void predict_batch(feature_type const* features, int const count, int* labels, double* scores = nullptr){
+			refresh_cache();
+			double local_score[label_count];
+			for(int i = 0; i < count; ++i){
+				double* output = (scores != nullptr ? scores + i * label_count : local_score);
+				labels[i] = compute_scores(features + i * feature_count, output);
 			}
-			return max_l;
 		}
 		/*
 		* Change the value of the smoothing.
@@ -101,6 +171,9 @@ class NaiveBayes{
 		*/
 		void set_smoothing(double const val){
 			smoothing = val;
+			for(int l = 0; l < label_count; ++l)
+				stale[l] = true;
+			stale_total = true;
 		}
 		/*
 		* Get the smoothing value.
@@ -109,4 +182,273 @@ class NaiveBayes{
 		double get_smoothing(void){
 			return smoothing;
 		}
+		/*
+		* Add the data points learned by another classifier, as if they had been learned by this one.
+		* Return false, without changing the classifier, if the classifiers do not have the same number of values per feature.
+		* @param other the other classifier.
+		*/
+		bool merge(NaiveBayes const& other){
+			for(int f = 0; f < feature_count; ++f)
+				if(features_size[f] != other.features_size[f])
+					return false;
+			for(int l = 0; l < label_count; ++l){
+				for(int f = 0; f < feature_count; ++f){
+					counters[l * feature_count + f].merge(other.counters[l * feature_count + f]);
+					for(int v = 0; v < value_count; ++v)
+						counts[l][f][v] += other.counts[l][f][v];
+				}
+				label_weights[l] += other.label_weights[l];
+				stale[l] = true;
+			}
+			total_weights += other.total_weights;
+			stale_total = true;
+			return true;
+		}
+		/*
+		* Return the number of bytes needed by *save*.
+		*/
+		int get_save_size(void) const{
+			return compute_save_size(features_size);
+		}
+		/*
+		* Save the state of the classifier in a buffer, in the byte order of the machine.
+		* Only the statistics used by the model of each feature are saved.
+		* Return the number of bytes written, or -1 if the buffer is too small.
+		* @param output the buffer.
+		* @param size the size of the buffer.
+		*/
+		int save(char* output, int const size) const{
+			int const needed = get_save_size();
+			if(size < needed)
+				return -1;
+			int const header[SAVE_HEADER_SIZE] = {SAVE_VERSION, label_count, feature_count, value_count};
+			write_bytes(output, header, sizeof(header));
+			write_bytes(output, features_size, sizeof(features_size));
+			write_bytes(output, &smoothing, sizeof(smoothing));
+			write_bytes(output, &total_weights, sizeof(total_weights));
+			write_bytes(output, label_weights, sizeof(label_weights));
+			for(int f = 0; f < feature_count; ++f){
+				int const model = features_model::model(f);
+				for(int l = 0; l < label_count; ++l){
+					if(model == NaiveBayesModel::GAUSSIAN)
+						write_bytes(output, &counters[l * feature_count + f], sizeof(GaussianEstimator<func>));
+					else if(model == NaiveBayesModel::CATEGORICAL)
+						write_bytes(output, counts[l][f], features_size[f] * sizeof(double));
+					else
+						write_bytes(output, counts[l][f], sizeof(double));
+				}
+			}
+			return needed;
+		}
+		/*
+		* Load the state of the classifier from a buffer written by *save* on a machine with the same byte order.
+		* Return false, without changing the classifier, if the buffer does not come from a classifier of the same type.
+		* @param input the buffer.
+		* @param size the size of the buffer.
+		*/
+		bool load(char const* input, int const size){
+			int const expected_header[SAVE_HEADER_SIZE] = {SAVE_VERSION, label_count, feature_count, value_count};
+			int header[SAVE_HEADER_SIZE];
+			int sizes[feature_count];
+			int const fixed_size = sizeof(header) + sizeof(sizes);
+			if(size < fixed_size)
+				return false;
+			read_bytes(input, header, sizeof(header));
+			read_bytes(input, sizes, sizeof(sizes));
+			for(int i = 0; i < SAVE_HEADER_SIZE; ++i)
+				if(header[i] != expected_header[i])
+					return false;
+			for(int f = 0; f < feature_count; ++f)
+				if(sizes[f] < 0 || sizes[f] > value_count)
+					return false;
+			//The size of the data depends on the number of values per feature
+			if(size < compute_save_size(sizes))
+				return false;
+			for(int f = 0; f < feature_count; ++f)
+				features_size[f] = sizes[f];
+			read_bytes(input, &smoothing, sizeof(smoothing));
+			read_bytes(input, &total_weights, sizeof(total_weights));
+			read_bytes(input, label_weights, sizeof(label_weights));
+			for(int f = 0; f < feature_count; ++f){
+				int const model = features_model::model(f);
+				for(int l = 0; l < label_count; ++l){
+					if(model == NaiveBayesModel::GAUSSIAN)
+						read_bytes(input, &counters[l * feature_count + f], sizeof(GaussianEstimator<func>));
+					else if(model == NaiveBayesModel::CATEGORICAL)
+						read_bytes(input, counts[l][f], features_size[f] * sizeof(double));
+					else
+						read_bytes(input, counts[l][f], sizeof(double));
+				}
+			}
+			for(int l = 0; l < label_count; ++l)
+				stale[l] = true;
+			stale_total = true;
+			return true;
+		}
+	private:
+		//The version of the format written by *save*, and the number of integers of its header (version, label_count, feature_count, value_count)
+		static int const SAVE_VERSION = 2;
+		static int const SAVE_HEADER_SIZE = 4;
+		/*
+		* Return the number of bytes needed by *save* for a classifier with *sizes* values per feature.
+		* @param sizes an array of size *feature_count* that contain how many value there is for each categorical feature.
+		*/
+		static int compute_save_size(int const* sizes){
+			int size = SAVE_HEADER_SIZE * sizeof(int) + feature_count * sizeof(int) + (2 + label_count) * sizeof(double);
+			for(int f = 0; f < feature_count; ++f){
+				int const model = features_model::model(f);
+				if(model == NaiveBayesModel::GAUSSIAN)
+					size += label_count * sizeof(GaussianEstimator<func>);
+				else if(model == NaiveBayesModel::CATEGORICAL)
+					size += label_count * sizes[f] * sizeof(double);
+				else
+					size += label_count * sizeof(double);
+			}
+			return size;
+		}
+		/*
+		* Copy bytes to a buffer and move the buffer after them.
+		* @param output the buffer.
+		* @param data the bytes to copy.
+		* @param size the number of bytes.
+		*/
+		static void write_bytes(char*& output, void const* data, int const size){
+			char const* bytes = reinterpret_cast<char const*>(data);
+			for(int i = 0; i < size; ++i)
+				output[i] = bytes[i];
+			output += size;
+		}
+		/*
+		* Copy bytes from a buffer and move the buffer after them.
+		* @param input the buffer.
+		* @param data the destination of the bytes.
+		* @param size the number of bytes.
+		*/
+		static void read_bytes(char const*& input, void* data, int const size){
+			char* bytes = reinterpret_cast<char*>(data);
+			for(int i = 0; i < size; ++i)
+				bytes[i] = input[i];
+			input += size;
+		}
+		/*
+		* Initialize the classifier.
+		* @param features_size an array of size *feature_count* that contain how many value there is for each categorical feature.
+		* @param smoothing the smoothing value to use.
+		*/
+		void init(int const* features_size, double const smoothing){
+			this->smoothing = smoothing;
+			for(int f = 0; f < feature_count; ++f){
+				this->features_size[f] = features_size[f];
+				if(this->features_size[f] > value_count)
+					this->features_size[f] = value_count;
+			}
+			for(int l = 0; l < label_count; ++l){
+				stale[l] = true;
+				for(int f = 0; f < feature_count; ++f)
+					for(int v = 0; v < value_count; ++v)
+						counts[l][f][v] = 0;
+			}
+		}
+		/*
+		* Compute the log-likelihood of the data point for each label and return the label with the highest one.
+		* The cache must be up to date.
+		* @param features an array of size *feature_count* that contains the value of the data point.
+		* @param scores a pointer of size *label_count* that will store the score for each label.
+		*/
+		int compute_scores(feature_type const* features, double* scores) const{
+			for(int l = 0; l < label_count; ++l)
+				scores[l] = biases[l] - log_total_weights;
+			for(int f = 0; f < feature_count; ++f){
+				int const model = features_model::model(f);
+				if(model == NaiveBayesModel::GAUSSIAN){
+					double const value = features[f];
+					for(int l = 0; l < label_count; ++l){
+						double const diff = value - means[f][l];
+						scores[l] -= diff * diff * precisions[f][l];
+					}
+				}
+				else if(model == NaiveBayesModel::CATEGORICAL){
+					int const value = static_cast<int>(features[f]);
+					//The values that do not fit in the table tell nothing about the label
+					if(value < 0 || value >= features_size[f])
+						continue;
+					for(int l = 0; l < label_count; ++l)
+						scores[l] += log_probabilities[f][value][l];
+				}
+				else{
+					double const value = features[f];
+					for(int l = 0; l < label_count; ++l)
+						scores[l] += value * log_probabilities[f][0][l];
+				}
+			}
+			int max_l = 0;
+			for(int l = 1; l < label_count; ++l){
+				if(scores[max_l] < scores[l])
+					max_l = l;
+			}
+			return max_l;
+		}
+		/*
+		* Compute the means, the precisions, the log-probabilities and the bias of the labels trained since the last refresh.
+		* The log-likelihood of a normal distribution is -log(sqrt(2*pi)) - log(stdev) - (x - mean)^2 / (2 * variance),
+		* it is computed with *func::log* so the scores keep the base of the logarithm given by the user.
+		* The probabilities of the discrete features are smoothed: (count + smoothing) / (total + smoothing * number of values).
+		*/
+		void refresh_cache(void){
+			if(!stale_total)
+				return;
+			double const infinity = std::numeric_limits<double>::infinity();
+			double const log_e = func::log(2.718281828459045);
+			double const log_normal_constant = func::log(2.50663); //square root of 2*M_PI
+			for(int l = 0; l < label_count; ++l){
+				if(!stale[l])
+					continue;
+				stale[l] = false;
+				//A label without data point has a probability of zero
+				biases[l] = (label_weights[l] > 0 ? func::log(label_weights[l]) : -infinity);
+				//The events of all multinomial features share the same total
+				int multinomial_features = 0;
+				double multinomial_total = 0;
+				for(int f = 0; f < feature_count; ++f){
+					if(features_model::model(f) == NaiveBayesModel::MULTINOMIAL){
+						multinomial_features += 1;
+						multinomial_total += counts[l][f][0];
+					}
+				}
+				double const log_multinomial_total = (multinomial_features > 0 ? func::log(multinomial_total + smoothing * multinomial_features) : 0);
+				for(int f = 0; f < feature_count; ++f){
+					int const model = features_model::model(f);
+					if(model == NaiveBayesModel::CATEGORICAL){
+						double total = 0;
+						for(int v = 0; v < features_size[f]; ++v)
+							total += counts[l][f][v];
+						double const log_total = func::log(total + smoothing * features_size[f]);
+						for(int v = 0; v < features_size[f]; ++v)
+							log_probabilities[f][v][l] = func::log(counts[l][f][v] + smoothing) - log_total;
+						continue;
+					}
+					if(model == NaiveBayesModel::MULTINOMIAL){
+						log_probabilities[f][0][l] = func::log(counts[l][f][0] + smoothing) - log_multinomial_total;
+						continue;
+					}
+					GaussianEstimator<func> const& estimator = counters[l * feature_count + f];
+					double const variance = estimator.get_variance();
+					means[f][l] = estimator.get_mean();
+					if(estimator.get_weight() <= 0){
+						precisions[f][l] = 0;
+						biases[l] = -infinity;
+					}
+					else if(variance > 0){
+						precisions[f][l] = log_e / (2 * variance);
+						biases[l] -= log_normal_constant + 0.5 * func::log(variance);
+					}
+					else{
+						//Without variance, the density is one at the mean and zero elsewhere
+						precisions[f][l] = std::numeric_limits<double>::max();
+					}
+				}
+			}
+			log_total_weights = func::log(total_weights);
+			stale_total = false;
+		}
 };
@@ -0,0 +1,141 @@
+#pragma once
+/**
+ * The optimizers adjust the weights of the perceptrons from their gradients.
+ * An optimizer provides:
+ * - state_size: the number of values it keeps for each weight. The perceptron stores them next to its weights, initialized to zero.
+ * - next_step(): called once before each adjustment of the weights, with one sample or one mini-batch.
+ * - update(weight, gradient, learning_rate, state): return the adjusted weight, and update the values kept for this weight in *state*.
+ * The update is called by the backward kernels while they go through the weights, so each weight is read and written once.
+ * All optimizers take the same *func* template parameter, a class type with the mathematical functions they need.
+ */
+
+/**
+ * Plain stochastic gradient descent: weight -= learning_rate * gradient.
+ * Templates:
+ * - func: a class type that contains all needed function for the optimizer (none).
+ */
+template<class func>
+class SGD{
+	public:
+	static int const state_size = 0;
+	void next_step(void){
+	}
+	double update(double const weight, double const gradient, double const learning_rate, double*) const{
+		return weight - learning_rate * gradient;
+	}
+};
+
+/**
+ * Gradient descent with momentum: velocity = momentum * velocity + gradient, then weight -= learning_rate * velocity.
+ * Templates:
+ * - func: a class type that contains all needed function for the optimizer (none).
+ */
+template<class func>
+class Momentum{
+	double momentum;
+	public:
+	static int const state_size = 1;
+	/**
+	 * The constructor of the momentum optimizer.
+	 * @param momentum The fraction of the previous velocity kept at each step.
+	 */
+	Momentum(double const momentum = 0.9){
+		this->momentum = momentum;
+	}
+	void next_step(void){
+	}
+	/**
+	 * Return the adjusted weight.
+	 * @param weight The weight.
+	 * @param gradient The gradient of the weight.
+	 * @param learning_rate The learning rate.
+	 * @param state The velocity of the weight.
+	 */
+	double update(double const weight, double const gradient, double const learning_rate, double* state) const{
+		double const velocity = momentum * state[0] + gradient;
+		state[0] = velocity;
+		return weight - learning_rate * velocity;
+	}
+};
+
+/**
+ * RMSProp: the gradient is divided by the root of the moving average of its square.
+ * Templates:
+ * - func: a class type that contains all needed function for the optimizer.
+ *   	+ sqrt function: a square root function.
+ */
+template<class func>
+class RMSProp{
+	double decay, epsilon;
+	public:
+	static int const state_size = 1;
+	/**
+	 * The constructor of RMSProp.
+	 * @param decay The fraction of the previous average kept at each step.
+	 * @param epsilon The value added to the root of the average to avoid divisions by zero.
+	 */
+	RMSProp(double const decay = 0.9, double const epsilon = 1e-8){
+		this->decay = decay;
+		this->epsilon = epsilon;
+	}
+	void next_step(void){
+	}
+	/**
+	 * Return the adjusted weight.
+	 * @param weight The weight.
+	 * @param gradient The gradient of the weight.
+	 * @param learning_rate The learning rate.
+	 * @param state The moving average of the square of the gradient.
+	 */
+	double update(double const weight, double const gradient, double const learning_rate, double* state) const{
+		double const average = decay * state[0] + (1 - decay) * gradient * gradient;
+		state[0] = average;
+		return weight - learning_rate * gradient / (func::sqrt(average) + epsilon);
+	}
+};
+
+/**
+ * Adam: the moving average of the gradient is divided by the root of the moving average of its square, both corrected for their
+ * initialization to zero. The correction is computed once per step, in *next_step*.
+ * Templates:
+ * - func: a class type that contains all needed function for the optimizer.
+ *   	+ sqrt function: a square root function.
+ */
+template<class func>
+class Adam{
+	double beta1, beta2, epsilon;
+	//beta1^t and beta2^t for the step t, and the correction of the learning rate for this step
+	double beta1_power = 1, beta2_power = 1, correction = 1;
+	public:
+	static int const state_size = 2;
+	/**
+	 * The constructor of Adam.
+	 * @param beta1 The fraction of the previous average of the gradient kept at each step.
+	 * @param beta2 The fraction of the previous average of the square of the gradient kept at each step.
+	 * @param epsilon The value added to the root of the average to avoid divisions by zero.
+	 */
+	Adam(double const beta1 = 0.9, double const beta2 = 0.999, double const epsilon = 1e-8){
+		this->beta1 = beta1;
+		this->beta2 = beta2;
+		this->epsilon = epsilon;
+	}
+	void next_step(void){
+		beta1_power *= beta1;
+		beta2_power *= beta2;
+		correction = func::sqrt(1 - beta2_power) / (1 - beta1_power);
+	}
+	/**
+	 * Return the adjusted weight.
+	 * @param weight The weight.
+	 * @param gradient The gradient of the weight.
+	 * @param learning_rate The learning rate.
+	 * @param state The moving averages of the gradient and of its square.
+	 */
+	double update(double const weight, double const gradient, double const learning_rate, double* state) const{
+		double const mean = beta1 * state[0] + (1 - beta1) * gradient;
+		double const square = beta2 * state[1] + (1 - beta2) * gradient * gradient;
+		state[0] = mean;
+		state[1] = square;
+		return weight - learning_rate * correction * mean / (func::sqrt(square) + epsilon);
+	}
+};
@@ -1,3 +1,297 @@
+#pragma once
+#include <type_traits>
+#include "optimizer.hpp"
+/**
+ * The kernels used by the layers of the perceptrons. A layer is stored as a row-major matrix, one row of *cols* weights per neuron,
+ * and its biases are stored separately, so each row is a contiguous dot product.
+ * The sizes of the kernels are either int or std::integral_constant<int, N>. With an integral_constant, the kernel is instantiated
+ * for this size, so the compiler knows the trip count of every loop.
+ */
+class PerceptronKernel{
+	public:
+	/**
+	 * Compute the linear combination of a layer: output = matrix * input + bias.
+	 * The rows are processed four at a time so each input value is loaded once for four neurons, and their sums are independent.
+	 * The partial sums change the order of the additions, so the result may differ from a sequential dot product in the last bits,
+	 * within the rounding error of the sum.
+	 * @param matrix The weights of the layer, *rows* x *cols*, row-major.
+	 * @param bias The biases of the layer, *rows* values.
+	 * @param input The input of the layer, *cols* values.
+	 * @param output The output of the layer, *rows* values.
+	 * @param rows The number of neurons of the layer.
+	 * @param cols The number of neurons of the previous layer.
+	 */
+	template<class rows_type, class cols_type>
+	static void gemv(double const* matrix, double const* bias, double const* input, double* output, rows_type const rows, cols_type const cols){
+		int const blocked_rows = rows - rows % 4;
+		for(int r = 0; r < blocked_rows; r += 4){
+			double const* row0 = matrix + r * cols;
+			double const* row1 = row0 + cols;
+			double const* row2 = row1 + cols;
+			double const* row3 = row2 + cols;
+			//Two sums per row, for the even and the odd columns, stored side by side so each pair can be computed with one vector operation
+			double sums[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+			int c = 0;
+			for(; c + 2 <= cols; c += 2){
+				double const x0 = input[c];
+				double const x1 = input[c+1];
+				sums[0] += row0[c] * x0;
+				sums[1] += row0[c+1] * x1;
+				sums[2] += row1[c] * x0;
+				sums[3] += row1[c+1] * x1;
+				sums[4] += row2[c] * x0;
+				sums[5] += row2[c+1] * x1;
+				sums[6] += row3[c] * x0;
+				sums[7] += row3[c+1] * x1;
+			}
+			if(c < cols){
+				double const x = input[c];
+				sums[0] += row0[c] * x;
+				sums[2] += row1[c] * x;
+				sums[4] += row2[c] * x;
+				sums[6] += row3[c] * x;
+			}
+			output[r] = sums[0] + sums[1] + bias[r];
+			output[r+1] = sums[2] + sums[3] + bias[r+1];
+			output[r+2] = sums[4] + sums[5] + bias[r+2];
+			output[r+3] = sums[6] + sums[7] + bias[r+3];
+		}
+		//The remaining rows use four partial sums each
+		for(int r = blocked_rows; r < rows; ++r){
+			double const* row = matrix + r * cols;
+			double sums[4] = {0, 0, 0, 0};
+			int c = 0;
+			for(; c + 4 <= cols; c += 4){
+				sums[0] += row[c] * input[c];
+				sums[1] += row[c+1] * input[c+1];
+				sums[2] += row[c+2] * input[c+2];
+				sums[3] += row[c+3] * input[c+3];
+			}
+			for(; c < cols; ++c)
+				sums[0] += row[c] * input[c];
+			output[r] = (sums[0] + sums[1]) + (sums[2] + sums[3]) + bias[r];
+		}
+	}
+	/**
+	 * Compute the linear combination of a layer for a batch of inputs: output = input * transpose(matrix) + bias.
+	 * The inputs are processed two at a time and the rows four at a time, so each weight is loaded once for two inputs
+	 * and each input value once for four neurons.
+	 * @param matrix The weights of the layer, *rows* x *cols*, row-major.
+	 * @param bias The biases of the layer, *rows* values.
+	 * @param input The inputs of the layer, *count* x *cols*, one input after the other.
+	 * @param output The outputs of the layer, *count* x *rows*, one output after the other.
+	 * @param rows The number of neurons of the layer.
+	 * @param cols The number of neurons of the previous layer.
+	 * @param count The number of inputs.
+	 */
+	template<class rows_type, class cols_type>
+	static void gemm(double const* matrix, double const* bias, double const* input, double* output, rows_type const rows, cols_type const cols, int const count){
+		int b = 0;
+		for(; b + 2 <= count; b += 2){
+			double const* input0 = input + b * cols;
+			double const* input1 = input0 + cols;
+			double* output0 = output + b * rows;
+			double* output1 = output0 + rows;
+			int r = 0;
+			for(; r + 4 <= rows; r += 4){
+				double const* row0 = matrix + r * cols;
+				double const* row1 = row0 + cols;
+				double const* row2 = row1 + cols;
+				double const* row3 = row2 + cols;
+				//Four sums per row, for the even and the odd columns of both inputs. The even and odd sums are side by side
+				//so each pair can be computed with one vector operation.
+				double sums[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+				int c = 0;
+				for(; c + 2 <= cols; c += 2){
+					double const x00 = input0[c], x01 = input0[c+1];
+					double const x10 = input1[c], x11 = input1[c+1];
+					sums[0] += row0[c] * x00;
+					sums[1] += row0[c+1] * x01;
+					sums[2] += row0[c] * x10;
+					sums[3] += row0[c+1] * x11;
+					sums[4] += row1[c] * x00;
+					sums[5] += row1[c+1] * x01;
+					sums[6] += row1[c] * x10;
+					sums[7] += row1[c+1] * x11;
+					sums[8] += row2[c] * x00;
+					sums[9] += row2[c+1] * x01;
+					sums[10] += row2[c] * x10;
+					sums[11] += row2[c+1] * x11;
+					sums[12] += row3[c] * x00;
+					sums[13] += row3[c+1] * x01;
+					sums[14] += row3[c] * x10;
+					sums[15] += row3[c+1] * x11;
+				}
+				if(c < cols){
+					for(int i = 0; i < 4; ++i){
+						double const w = matrix[(r+i) * cols + c];
+						sums[4*i] += w * input0[c];
+						sums[4*i+2] += w * input1[c];
+					}
+				}
+				for(int i = 0; i < 4; ++i){
+					output0[r+i] = sums[4*i] + sums[4*i+1] + bias[r+i];
+					output1[r+i] = sums[4*i+2] + sums[4*i+3] + bias[r+i];
+				}
+			}
+			for(; r < rows; ++r){
+				double const* row = matrix + r * cols;
+				double sum0 = 0, sum1 = 0;
+				for(int c = 0; c < cols; ++c){
+					sum0 += row[c] * input0[c];
+					sum1 += row[c] * input1[c];
+				}
+				output0[r] = sum0 + bias[r];
+				output1[r] = sum1 + bias[r];
+			}
+		}
+		if(b < count)
+			gemv(matrix, bias, input + b * cols, output + b * rows, rows, cols);
+	}
+	/**
+	 * Apply the activation function to the output of a layer, in place.
+	 * Templates:
+	 * - func: a class type that contains the activation function.
+	 * @param values The output of the layer.
+	 * @param count The number of neurons of the layer.
+	 */
+	template<class func, class count_type>
+	static void activate(double* values, count_type const count){
+		for(int i = 0; i < count; ++i)
+			values[i] = func::activation(values[i]);
+	}
+	/**
+	 * Propagate the errors of a layer to the previous layer and adjust the weights of the layer with an optimizer.
+	 * The errors are computed with the weights before their adjustment, in the same pass as the adjustment.
+	 * The columns are processed by chunks so the rows of the matrix are read contiguously.
+	 * Templates:
+	 * - func: a class type that contains the derivative of the activation function.
+	 * - optimizer: the optimizer that adjusts the weights (see optimizer.hpp).
+	 * @param matrix The weights of the layer, *rows* x *cols*, row-major.
+	 * @param bias The biases of the layer, *rows* values.
+	 * @param previous The output of the previous layer, *cols* values, replaced by the errors of the previous layer.
+	 * @param error The errors of the layer, *rows* values.
+	 * @param rows The number of neurons of the layer.
+	 * @param cols The number of neurons of the previous layer.
+	 * @param learning_rate The learning rate.
+	 * @param adjuster The optimizer.
+	 * @param matrix_state The state of the optimizer for the weights, *state_size* values per weight.
+	 * @param bias_state The state of the optimizer for the biases, *state_size* values per bias.
+	 */
+	template<class func, class optimizer, class rows_type, class cols_type>
+	static void backward(double* matrix, double* bias, double* previous, double const* error, rows_type const rows, cols_type const cols, double const learning_rate,
+			optimizer const& adjuster, double* matrix_state, double* bias_state){
+		int const state_size = optimizer::state_size;
+		for(int start = 0; start < cols; start += BACKWARD_CHUNK){
+			int const size = (cols - start < BACKWARD_CHUNK ? cols - start : BACKWARD_CHUNK);
+			double const* output = previous + start;
+			double sums[BACKWARD_CHUNK] = {0};
+			for(int r = 0; r < rows; ++r){
+				double* row = matrix + r * cols + start;
+				double* row_state = matrix_state + (r * cols + start) * state_size;
+				double const e = error[r];
+				for(int c = 0; c < size; ++c){
+					sums[c] += e * row[c];
+					row[c] = adjuster.update(row[c], e * output[c], learning_rate, row_state + c * state_size);
+				}
+			}
+			for(int c = 0; c < size; ++c)
+				previous[start + c] = sums[c] * func::derivative(output[c]);
+		}
+		//The bias neuron always outputs 1
+		for(int r = 0; r < rows; ++r)
+			bias[r] = adjuster.update(bias[r], error[r], learning_rate, bias_state + r * state_size);
+	}
+	/**
+	 * Propagate the errors of a layer to the previous layer for a batch of data points, and adjust the weights of the layer
+	 * once with the mean of their gradients and an optimizer.
+	 * The errors are computed with the weights before their adjustment, in *scratch*, because the outputs of the previous layer
+	 * are needed by the adjustment.
+	 * Templates:
+	 * - func: a class type that contains the derivative of the activation function.
+	 * - optimizer: the optimizer that adjusts the weights (see optimizer.hpp).
+	 * @param matrix The weights of the layer, *rows* x *cols*, row-major.
+	 * @param bias The biases of the layer, *rows* values.
+	 * @param previous The outputs of the previous layer, *count* x *cols*, replaced by the errors of the previous layer.
+	 * @param error The errors of the layer, *count* x *rows*.
+	 * @param scratch An array of *count* x *cols* values.
+	 * @param rows The number of neurons of the layer.
+	 * @param cols The number of neurons of the previous layer.
+	 * @param count The number of data points.
+	 * @param learning_rate The learning rate.
+	 * @param adjuster The optimizer.
+	 * @param matrix_state The state of the optimizer for the weights, *state_size* values per weight.
+	 * @param bias_state The state of the optimizer for the biases, *state_size* values per bias.
+	 */
+	template<class func, class optimizer, class rows_type, class cols_type>
+	static void backward_batch(double* matrix, double* bias, double* previous, double const* error, double* scratch, rows_type const rows, cols_type const cols, int const count,
+			double const learning_rate, optimizer const& adjuster, double* matrix_state, double* bias_state){
+		int const state_size = optimizer::state_size;
+		//The errors of the previous layer: scratch = error * matrix, four rows at a time
+		for(int b = 0; b < count; ++b){
+			double const* e = error + b * rows;
+			double* sums = scratch + b * cols;
+			for(int c = 0; c < cols; ++c)
+				sums[c] = 0;
+			int r = 0;
+			for(; r + 4 <= rows; r += 4){
+				double const* row0 = matrix + r * cols;
+				double const* row1 = row0 + cols;
+				double const* row2 = row1 + cols;
+				double const* row3 = row2 + cols;
+				double const e0 = e[r], e1 = e[r+1], e2 = e[r+2], e3 = e[r+3];
+				for(int c = 0; c < cols; ++c)
+					sums[c] += (e0 * row0[c] + e1 * row1[c]) + (e2 * row2[c] + e3 * row3[c]);
+			}
+			for(; r < rows; ++r){
+				double const* row = matrix + r * cols;
+				double const er = e[r];
+				for(int c = 0; c < cols; ++c)
+					sums[c] += er * row[c];
+			}
+		}
+		//The adjustment of the weights: the gradient transpose(error) * previous is summed by chunks of columns, four data points at a time,
+		//then each weight is adjusted once with the mean gradient
+		double const inverse_count = 1.0 / count;
+		for(int r = 0; r < rows; ++r){
+			for(int start = 0; start < cols; start += BACKWARD_CHUNK){
+				int const size = (cols - start < BACKWARD_CHUNK ? cols - start : BACKWARD_CHUNK);
+				double gradients[BACKWARD_CHUNK] = {0};
+				int b = 0;
+				for(; b + 4 <= count; b += 4){
+					double const* output0 = previous + b * cols + start;
+					double const* output1 = output0 + cols;
+					double const* output2 = output1 + cols;
+					double const* output3 = output2 + cols;
+					double const e0 = error[b * rows + r], e1 = error[(b+1) * rows + r], e2 = error[(b+2) * rows + r], e3 = error[(b+3) * rows + r];
+					for(int c = 0; c < size; ++c)
+						gradients[c] += (e0 * output0[c] + e1 * output1[c]) + (e2 * output2[c] + e3 * output3[c]);
+				}
+				for(; b < count; ++b){
+					double const* output = previous + b * cols + start;
+					double const e = error[b * rows + r];
+					for(int c = 0; c < size; ++c)
+						gradients[c] += e * output[c];
+				}
+				double* row = matrix + r * cols + start;
+				double* row_state = matrix_state + (r * cols + start) * state_size;
+				for(int c = 0; c < size; ++c)
+					row[c] = adjuster.update(row[c], gradients[c] * inverse_count, learning_rate, row_state + c * state_size);
+			}
+			//The bias neuron always outputs 1
+			double bias_gradient = 0;
+			for(int b = 0; b < count; ++b)
+				bias_gradient += error[b * rows + r];
+			bias[r] = adjuster.update(bias[r], bias_gradient * inverse_count, learning_rate, bias_state + r * state_size);
+		}
+		for(int i = 0; i < count * cols; ++i)
+			previous[i] = scratch[i] * func::derivative(previous[i]);
+	}
+	private:
+	//The number of columns processed together by *backward*
+	static int const BACKWARD_CHUNK = 64;
+};
+
 /**
  * Implement a Multi-Layers Perceptron object. The network is divided by layers and each layer of perceptron is fully connected to the previous one.
  * - layer_count: the number of layer.
@@ -6,38 +300,80 @@
  *   	+ random function: A function that returns a random number between 0 and 1, to initialize the weights.
  *   	+ activation function: A function that act as the activation function.
  *   	+ derivative function: The derivative of the activation function.
+ *   	+ the functions needed by the optimizer.
+ * - optimizer: the optimizer that adjusts the weights during the backpropagation (see optimizer.hpp). The memory is shared between
+ *   the weights, the state of the optimizer and the outputs of the neurons, so an optimizer with a state leaves room for less weights.
  */
-template<int layer_count, int max_size, class func>
+template<int layer_count, int max_size, class func, class optimizer = SGD<func>>
 class MultiLayerPerceptron{
-	static const int total_weight_count = ((max_size + sizeof(double) - max_size%sizeof(double)) / sizeof(double))/2;
+	static const int total_weight_count = ((max_size + sizeof(double) - max_size%sizeof(double)) / sizeof(double))/(2 + optimizer::state_size);
 	double learning_rate = 0.1;
-	//Contains the weights of the network.
-	double weights[total_weight_count];
+	optimizer adjuster;
+	//Contains the weights of the network. Each layer is a row-major matrix with one row per neuron, followed by the biases of its neurons.
+	//The state of the optimizer follows, with *state_size* values for each weight.
+	double weights[total_weight_count * (1 + optimizer::state_size)];
 	//Contain the last output of each neuron or the last backpropagation error depending on the last function called.
 	double neuron_output[total_weight_count];
 
 	//The size of each layer.
 	int layer_size[layer_count];
+	//The index of the matrix of each layer in *weights* and the index of the output of each layer in *neuron_output*
+	int weight_base[layer_count];
+	int output_base[layer_count];
+	//The number of data points that *neuron_output* holds in batch mode
+	int batch_capacity;
 
 	/**
 	 * Return the the base index of the of the layer layer_idx in the array weights.
 	 * @param layer_idx The index of the layer targeted. It should start at 1 since the layer 0 doesn't have weights (it's the input layer).
 	 */
 	int get_weight_base(int const layer_idx) const{
-		int layer_base = 0;
-		for(int i = 1; i < layer_idx; ++i)
-			layer_base += (layer_size[i-1]+1) * layer_size[i];
-		return layer_base;
+		return weight_base[layer_idx];
+	}
+	/**
+	 * Return the base index of the biases of the layer layer_idx in the array weights. The biases are right after the matrix of the layer.
+	 * @param layer_idx The index of the layer targeted. It should start at 1 since the layer 0 doesn't have weights (it's the input layer).
+	 */
+	int get_bias_base(int const layer_idx) const{
+		return weight_base[layer_idx] + layer_size[layer_idx-1] * layer_size[layer_idx];
+	}
+	/**
+	 * Return the state of the optimizer for the weight at *weight_idx* in the array weights.
+	 * @param weight_idx The index of the weight.
+	 */
+	double* get_state(int const weight_idx){
+		return weights + total_weight_count + weight_idx * optimizer::state_size;
 	}
 	/**
 	 * Return the the base index of the of the layer layer_idx in the array neuron_output.
 	 * @param layer_idx The index of the layer targeted. It should start at 0 since it is the input layer.
 	 */
 	int get_output_base(int const layer_idx) const{
-		int layer_base = 0;
-		for(int i = 0; i < layer_idx; ++i)
-			layer_base += layer_size[i];
-		return layer_base;
+		return output_base[layer_idx];
+	}
+	/**
+	 * Return the base index of the outputs of the layer layer_idx in the array neuron_output in batch mode.
+	 * In batch mode, each layer holds the outputs of *batch_capacity* data points, one after the other, and the scratch area
+	 * used by the backpropagation is after the last layer.
+	 * @param layer_idx The index of the layer targeted. It should start at 0 since it is the input layer.
+	 */
+	int get_batch_output_base(int const layer_idx) const{
+		return output_base[layer_idx] * batch_capacity;
+	}
+	/**
+	 * Pass a batch of inputs through the neural network, leaving the outputs of each layer in *neuron_output*.
+	 * @param input The inputs, one after the other.
+	 * @param count The number of inputs, at most *batch_capacity*.
+	 */
+	void forward_batch(double const* input, int const count){
+		double* input_output = neuron_output + get_batch_output_base(0);
+		for(int i = 0; i < count * layer_size[0]; ++i)
+			input_output[i] = input[i];
+		for(int layer_idx = 1; layer_idx < layer_count; ++layer_idx){
+			double* layer_output = neuron_output + get_batch_output_base(layer_idx);
+			PerceptronKernel::gemm(weights + weight_base[layer_idx], weights + get_bias_base(layer_idx), neuron_output + get_batch_output_base(layer_idx-1), layer_output, layer_size[layer_idx], layer_size[layer_idx-1], count);
+			PerceptronKernel::activate<func>(layer_output, count * layer_size[layer_idx]);
+		}
 	}
 	public:
 		/**
@@ -50,14 +386,29 @@ class MultiLayerPerceptron{
 			for(int i = 0; i < layer_count; ++i){
 				this->layer_size[i] = layer_size[i];
 			}
+			//The layer 0 has no weights
+			weight_base[0] = 0;
+			output_base[0] = 0;
+			for(int i = 1; i < layer_count; ++i){
+				weight_base[i] = (i > 1 ? weight_base[i-1] + (layer_size[i-2]+1) * layer_size[i-1] : 0); //+1 because of the bias neuron
+				output_base[i] = output_base[i-1] + layer_size[i-1];
+			}
+			//In batch mode, each data point needs the outputs of all layers and a scratch area as large as the largest layer with weights after it
+			int const output_count = output_base[layer_count-1] + layer_size[layer_count-1];
+			int max_previous_size = 0;
+			for(int i = 0; i < layer_count-1; ++i)
+				max_previous_size = (layer_size[i] > max_previous_size ? layer_size[i] : max_previous_size);
+			batch_capacity = total_weight_count / (output_count + max_previous_size);
 			//Randomly initialize the weights
 			for(int i = 0; i < total_weight_count; ++i)
 				weights[i] = func::random();
+			for(int i = total_weight_count; i < total_weight_count * (1 + optimizer::state_size); ++i)
+				weights[i] = 0;
 		}
 		/**
 		 * Pass the input trough the neural network.
 		 * @param input The input value for the first layer of the neural network. Should be in the size of the first layer
-		 * @param output The result of the last layer. Should be in the size of the last layer.
+		 * @param output The result of the last layer. Should be in the size of the last layer. Can be null when only the outputs kept in the network are needed.
 		 */
 		void feed_forward(double const* input, double* output){
 			//Initialize input neuron
@@ -65,39 +416,90 @@ class MultiLayerPerceptron{
 				neuron_output[neuron_idx] = input[neuron_idx];
 			}
 
-			//Initialize the base index used at each layer
-			int output_base = 0;
-			int weight_base = 0;
-
-			//Feed forward for each layer
+			//Feed forward for each layer: the linear combination of the previous layer (including the bias), then the activation
 			for(int layer_idx = 1; layer_idx < layer_count; ++layer_idx){
-				//For each neuron, we do the linear combination of the previous layer (including the bias)
-				for(int neuron_idx = 0; neuron_idx < layer_size[layer_idx]; ++neuron_idx){ 
-
-					double sum = 0;
-					for(int weight_idx = 0; weight_idx < layer_size[layer_idx-1]; ++weight_idx){
-						//Compute the index in *weights* and the index in *neuron_output* in the previous layer
-						int weight_global_idx = weight_base + neuron_idx * (layer_size[layer_idx-1]+1) + weight_idx; //+1 because of the bias neuron
-						int input_global_idx = output_base + weight_idx;
-						sum += weights[weight_global_idx] * neuron_output[input_global_idx];
-					}
-					//Grab the bias neuron
-					int weight_global_idx = weight_base + neuron_idx * (layer_size[layer_idx-1]+1) + layer_size[layer_idx-1];
-					sum += weights[weight_global_idx];
+				double* layer_output = neuron_output + output_base[layer_idx];
+				PerceptronKernel::gemv(weights + weight_base[layer_idx], weights + get_bias_base(layer_idx), neuron_output + output_base[layer_idx-1], layer_output, layer_size[layer_idx], layer_size[layer_idx-1]);
+				PerceptronKernel::activate<func>(layer_output, layer_size[layer_idx]);
+			}
 
-					//Compute the index of the current neuron in *neuron_output* to store its result
-					int output_global_index = output_base + layer_size[layer_idx-1] + neuron_idx;
-					neuron_output[output_global_index] = func::activation(sum);	
+			//Write the result of the last layer in *output*
+			double const* last_output = neuron_output + output_base[layer_count-1];
+			for(int neuron_idx = 0; output != nullptr && neuron_idx < layer_size[layer_count-1]; ++neuron_idx){
+				output[neuron_idx] = last_output[neuron_idx];
+			}
+		}
+		/**
+		 * Change the optimizer, for instance to change its parameters. The state of the optimizer for each weight is kept.
+		 * @param new_optimizer The new optimizer.
+		 */
+		void set_optimizer(optimizer const& new_optimizer){
+			adjuster = new_optimizer;
+		}
+		/**
+		 * Pass a batch of inputs through the neural network.
+		 * The inputs are processed by groups of at most *get_batch_capacity()* inputs.
+		 * This function uses the same memory as *feed_forward*, so *backpropagate* must be called after *feed_forward* only.
+		 * @param input The inputs, one after the other. Each input should be in the size of the first layer.
+		 * @param output The results of the last layer, one after the other. Should be in the size of the last layer times *count*.
+		 * @param count The number of inputs.
+		 */
+		void feed_forward_batch(double const* input, double* output, int const count){
+			int const input_size = layer_size[0];
+			int const output_size = layer_size[layer_count-1];
+			double const* last_output = neuron_output + get_batch_output_base(layer_count-1);
+			for(int start = 0; batch_capacity > 0 && start < count; start += batch_capacity){
+				int const size = (count - start < batch_capacity ? count - start : batch_capacity);
+				forward_batch(input + start * input_size, size);
+				for(int i = 0; i < size * output_size; ++i)
+					output[start * output_size + i] = last_output[i];
+			}
+		}
+		/**
+		 * Train the network on a batch of data points with mini-batch gradient descent.
+		 * The data points are split into mini-batches of at most *get_batch_capacity()* data points, and the weights are adjusted
+		 * once per mini-batch, with the mean of the gradients of its data points.
+		 * This function uses the same memory as *feed_forward*, so *backpropagate* must be called after *feed_forward* only.
+		 * @param input The inputs, one after the other. Each input should be in the size of the first layer.
+		 * @param expected The expected outputs, one after the other. Each output should be in the size of the last layer.
+		 * @param count The number of data points.
+		 * @return The mean squared error of the outputs before the adjustments.
+		 */
+		double train_batch(double const* input, double const* expected, int const count){
+			int const input_size = layer_size[0];
+			int const output_size = layer_size[layer_count-1];
+			int const scratch_base = get_batch_output_base(layer_count-1) + batch_capacity * output_size;
+			double sum_error_output = 0;
+			for(int start = 0; batch_capacity > 0 && start < count; start += batch_capacity){
+				int const size = (count - start < batch_capacity ? count - start : batch_capacity);
+				forward_batch(input + start * input_size, size);
+				adjuster.next_step();
 
+				//Set the error of the last layer
+				double* last_output = neuron_output + get_batch_output_base(layer_count-1);
+				double const* batch_expected = expected + start * output_size;
+				for(int i = 0; i < size * output_size; ++i){
+					double const output = last_output[i];
+					double const err = output - batch_expected[i];
+					sum_error_output += (err*err);
+					last_output[i] = func::derivative(output) * err;
 				}
-				weight_base += layer_size[layer_idx] * (layer_size[layer_idx-1]+1); //+1 because of the bias neuron
-				output_base += layer_size[layer_idx-1]; //There is not +1 for the neuron output because the bias is alway 1 and never stored
-			}
 
-			//Write the result of the last layer in *output*
-			for(int neuron_idx = 0; neuron_idx < layer_size[layer_count-1]; ++neuron_idx){
-				output[neuron_idx] = neuron_output[output_base + neuron_idx];
+				for(int layer_idx = layer_count - 2; layer_idx >= 0; --layer_idx){
+					PerceptronKernel::backward_batch<func>(weights + weight_base[layer_idx+1], weights + get_bias_base(layer_idx+1),
+							neuron_output + get_batch_output_base(layer_idx), neuron_output + get_batch_output_base(layer_idx+1),
+							neuron_output + scratch_base, layer_size[layer_idx+1], layer_size[layer_idx], size, learning_rate,
+							adjuster, get_state(weight_base[layer_idx+1]), get_state(get_bias_base(layer_idx+1)));
+				}
 			}
+			return (count > 0 ? sum_error_output / (count * output_size) : 0);
+		}
+		/**
+		 * Return the number of data points processed together by *feed_forward_batch* and *train_batch*.
+		 * It depends on the memory left by the weights in *max_size*.
+		 */
+		int get_batch_capacity(void) const{
+			return batch_capacity;
 		}
 		/**
 		 * Set the input weights of one neuron.
@@ -106,93 +508,333 @@ class MultiLayerPerceptron{
 		 * @param new_weights An array in the size of the previous layer plus one that contains the new weights. The last weight is for the bias.
 		 */
 		void set_weights(int layer_idx, int neuron_idx, double* new_weights){
-			int base_index = 0;
-			for(int l = 1; l < layer_idx; ++l)
-				base_index += layer_size[l] * (layer_size[l-1]+1);
-			
-			base_index += (layer_size[layer_idx-1]+1) * neuron_idx;
-			for(int i = 0; i < layer_size[layer_idx-1]+1; ++i)
-				weights[base_index + i] = new_weights[i];
+			int const cols = layer_size[layer_idx-1];
+			double* row = weights + weight_base[layer_idx] + neuron_idx * cols;
+			for(int i = 0; i < cols; ++i)
+				row[i] = new_weights[i];
+			weights[get_bias_base(layer_idx) + neuron_idx] = new_weights[cols];
 		}
 		/**
 		 * Set the input weights of one layer.
 		 * @param layer_idx The layer where the neuron is. Must be greater or equal to 1, because the first layer do not have weights.
-		 * @param new_weights An array in the size of ((previous_layer_size+1) * current_layer) that contains the new weights. 
+		 * @param new_weights An array in the size of ((previous_layer_size+1) * current_layer) that contains the new weights.
+		 * The weights are given neuron after neuron, and the last weight of each neuron is for the bias.
 		 */
 		void set_weights(int layer_idx, double* new_weights){
-			int base_index = 0;
-			for(int l = 1; l < layer_idx; ++l)
-				base_index += layer_size[l] * (layer_size[l-1]+1);
-			
-			for(int i = 0; i < (layer_size[layer_idx-1]+1) * layer_size[layer_idx]; ++i)
-				weights[base_index + i] = new_weights[i];
+			for(int neuron_idx = 0; neuron_idx < layer_size[layer_idx]; ++neuron_idx)
+				set_weights(layer_idx, neuron_idx, new_weights + neuron_idx * (layer_size[layer_idx-1]+1));
 		}
 		/**
 		 * Set the input weights of the network.
-		 * @param new_weights An array that contains the new weights. 
+		 * @param new_weights An array that contains the new weights, layer after layer, as given to *set_weights* for one layer.
 		 */
 		void set_weights(double* new_weights){
-			int base_index = 0;
-			for(int l = 1; l < layer_count; ++l){
-				for(int i = 0; i < (layer_size[l-1]+1) * layer_size[l]; ++i)
-					weights[base_index + i] = new_weights[base_index + i];
-				base_index += (layer_size[l-1]+1) * layer_size[l];
-			}
+			for(int l = 1; l < layer_count; ++l)
+				set_weights(l, new_weights + weight_base[l]);
 		}
 		/**
 		 * Return the array of weights.
+		 * Each layer is stored as a row-major matrix with one row per neuron, followed by the biases of the neurons.
 		 */
 		double* const get_weights(void){
 			return static_cast<double* const>(static_cast<void*>(weights));
 		}
+		/**
+		 * Return the number of neurons of one layer.
+		 * @param layer_idx The index of the layer.
+		 */
+		int get_layer_size(int const layer_idx) const{
+			return layer_size[layer_idx];
+		}
+		/**
+		 * Return the weights of one layer, a row-major matrix with one row of (previous layer size) weights per neuron.
+		 * @param layer_idx The index of the layer. Must be greater or equal to 1, because the first layer do not have weights.
+		 */
+		double const* get_layer_weights(int const layer_idx) const{
+			return weights + weight_base[layer_idx];
+		}
+		/**
+		 * Return the biases of one layer, one per neuron.
+		 * @param layer_idx The index of the layer. Must be greater or equal to 1, because the first layer do not have weights.
+		 */
+		double const* get_layer_biases(int const layer_idx) const{
+			return weights + get_bias_base(layer_idx);
+		}
+		/**
+		 * Return the outputs of one layer computed by the last call to feed_forward.
+		 * @param layer_idx The index of the layer.
+		 */
+		double const* get_layer_output(int const layer_idx) const{
+			return neuron_output + output_base[layer_idx];
+		}
 		/**
 		 * Run the backpropagation step based on the expected value and the last call to feed_forward.
 		 * @param expected .
 		 */
 		double backpropagate(double const* expected){
-			int output_base = get_output_base(layer_count-1);
-			int weight_base = get_weight_base(layer_count-1);
+			int const last_base = output_base[layer_count-1];
 
 			double sum_error_output = 0;
 			//Set the error of the last layer
 			for(int i = 0; i < layer_size[layer_count-1]; ++i){
-				int output_global_index = output_base + i;
+				int output_global_index = last_base + i;
 				double output = neuron_output[output_global_index];
 				double err = output - expected[i];
 				sum_error_output += (err*err);
-				neuron_output[output_global_index] = func::derivative(output) * err; 
+				neuron_output[output_global_index] = func::derivative(output) * err;
 			}
 
+			//The errors of the layer *layer_idx+1* are propagated to the layer *layer_idx*, and the weights between both are adjusted
+			adjuster.next_step();
 			for(int layer_idx = layer_count - 2; layer_idx >= 0; --layer_idx){
-				output_base -= layer_size[layer_idx];
-				weight_base -= (layer_size[layer_idx-1]+1) * layer_size[layer_idx];
-				for(int neuron_idx = 0; neuron_idx <= layer_size[layer_idx]; ++neuron_idx){
-					double neuron_error = 0;
-					double current_neuron_output = 1;
-					if(neuron_idx < layer_size[layer_idx])
-						current_neuron_output = neuron_output[output_base + neuron_idx];
-					for(int weight_idx = 0; weight_idx < layer_size[layer_idx+1]; ++weight_idx){
-
-						int neuron_next_layer = output_base + layer_size[layer_idx] + weight_idx;
-						int weight_next_layer = weight_base + (layer_size[layer_idx-1]+1) * layer_size[layer_idx] + weight_idx * (layer_size[layer_idx]+1) + neuron_idx;
-						neuron_error += neuron_output[neuron_next_layer] * weights[weight_next_layer];
-					}
-					neuron_error *= func::derivative(current_neuron_output);
-
-					//Second loop to adjust the weights
-					for(int weight_idx = 0; weight_idx < layer_size[layer_idx+1]; ++weight_idx){
-
-						int neuron_next_layer = output_base + layer_size[layer_idx] + weight_idx;
-						int weight_next_layer = weight_base + (layer_size[layer_idx-1]+1) * layer_size[layer_idx] + weight_idx * (layer_size[layer_idx]+1) + neuron_idx;
-						double d_weight = - learning_rate * current_neuron_output * neuron_output[neuron_next_layer];
-						weights[weight_next_layer] += d_weight;
-					}
-					if(neuron_idx < layer_size[layer_idx])
-						neuron_output[output_base + neuron_idx] = neuron_error;
-				}
+				PerceptronKernel::backward<func>(weights + weight_base[layer_idx+1], weights + get_bias_base(layer_idx+1), neuron_output + output_base[layer_idx],
+						neuron_output + output_base[layer_idx+1], layer_size[layer_idx+1], layer_size[layer_idx], learning_rate,
+						adjuster, get_state(weight_base[layer_idx+1]), get_state(get_bias_base(layer_idx+1)));
 			}
 
 			return (sum_error_output/layer_size[layer_count-1]);
 		}
 };
 
+/**
+ * The shape of a network known at compile time: the size of each layer and the position of each layer in the arrays of weights
+ * and outputs. The layout is the same as in MultiLayerPerceptron.
+ * Templates:
+ * - first: the size of the first layer.
+ * - rest: the sizes of the next layers.
+ */
+template<int first, int... rest>
+class PerceptronLayers{
+	typedef PerceptronLayers<rest...> next;
+	public:
+	/**
+	 * Return the number of layers.
+	 */
+	static constexpr int count(void){
+		return 1 + next::count();
+	}
+	/**
+	 * Return the size of the layer layer_idx.
+	 * @param layer_idx The index of the layer.
+	 */
+	static constexpr int size(int const layer_idx){
+		return layer_idx == 0 ? first : next::size(layer_idx - 1);
+	}
+	/**
+	 * Return the number of weights of the network, including the biases.
+	 */
+	static constexpr int weight_count(void){
+		return (first + 1) * next::size(0) + next::weight_count();
+	}
+	/**
+	 * Return the number of neurons of the network.
+	 */
+	static constexpr int output_count(void){
+		return first + next::output_count();
+	}
+	/**
+	 * Return the base index of the layer layer_idx in the array of weights.
+	 * @param layer_idx The index of the layer. It should start at 1 since the layer 0 doesn't have weights (it's the input layer).
+	 */
+	static constexpr int weight_base(int const layer_idx){
+		return layer_idx <= 1 ? 0 : (first + 1) * next::size(0) + next::weight_base(layer_idx - 1);
+	}
+	/**
+	 * Return the base index of the biases of the layer layer_idx in the array of weights. The biases are right after the matrix of the layer.
+	 * @param layer_idx The index of the layer. It should start at 1 since the layer 0 doesn't have weights (it's the input layer).
+	 */
+	static constexpr int bias_base(int const layer_idx){
+		return weight_base(layer_idx) + size(layer_idx - 1) * size(layer_idx);
+	}
+	/**
+	 * Return the base index of the layer layer_idx in the array of outputs.
+	 * @param layer_idx The index of the layer.
+	 */
+	static constexpr int output_base(int const layer_idx){
+		return layer_idx == 0 ? 0 : first + next::output_base(layer_idx - 1);
+	}
+};
+template<int last>
+class PerceptronLayers<last>{
+	public:
+	static constexpr int count(void){
+		return 1;
+	}
+	static constexpr int size(int const){
+		return last;
+	}
+	static constexpr int weight_count(void){
+		return 0;
+	}
+	static constexpr int output_count(void){
+		return last;
+	}
+	static constexpr int weight_base(int const){
+		return 0;
+	}
+	static constexpr int output_base(int const){
+		return 0;
+	}
+};
+
+/**
+ * Implement a Multi-Layers Perceptron object whose layer sizes are known at compile time. It behaves like MultiLayerPerceptron,
+ * but the arrays of weights and outputs have the exact size of the network, and the kernels of each layer are instantiated for its size.
+ * - func: a class type that contains all needed function for the StaticMultiLayerPerceptron.
+ *   	+ random function: A function that returns a random number between 0 and 1, to initialize the weights.
+ *   	+ activation function: A function that act as the activation function.
+ *   	+ derivative function: The derivative of the activation function.
+ *   	+ the functions needed by the optimizer.
+ * - optimizer: the optimizer that adjusts the weights during the backpropagation (see optimizer.hpp). Its state follows the weights.
+ *   The network inherits from the optimizer, so an optimizer without members such as SGD takes no memory.
+ * - layer_sizes: the size of each layer, from the input layer to the output layer. There must be at least two layers.
+ */
+template<class func, class optimizer, int... layer_sizes>
+class StaticMultiLayerPerceptron : private optimizer{
+	typedef PerceptronLayers<layer_sizes...> layers;
+	template<int value>
+	using constant = std::integral_constant<int, value>;
+	static int const layer_count = sizeof...(layer_sizes);
+	static int const input_size = layers::size(0);
+	static int const output_size = layers::size(layer_count - 1);
+	static_assert(layer_count >= 2, "A network needs an input layer and an output layer.");
+
+	static int const state_size = optimizer::state_size;
+
+	double learning_rate = 0.1;
+	//Contains the weights of the network. Each layer is a row-major matrix with one row per neuron, followed by the biases of its neurons.
+	//The state of the optimizer follows, with *state_size* values for each weight.
+	double weights[layers::weight_count() * (1 + state_size)];
+	//Contain the last output of each neuron or the last backpropagation error depending on the last function called.
+	double neuron_output[layers::output_count()];
+
+	/**
+	 * Feed forward the layer layer_idx, then the next layers.
+	 * @param layer_idx The index of the layer.
+	 */
+	template<int layer_idx>
+	void feed_forward_layer(constant<layer_idx>){
+		double* layer_output = neuron_output + layers::output_base(layer_idx);
+		PerceptronKernel::gemv(weights + layers::weight_base(layer_idx), weights + layers::bias_base(layer_idx), neuron_output + layers::output_base(layer_idx-1), layer_output,
+				constant<layers::size(layer_idx)>(), constant<layers::size(layer_idx-1)>());
+		PerceptronKernel::activate<func>(layer_output, constant<layers::size(layer_idx)>());
+		feed_forward_layer(constant<layer_idx+1>());
+	}
+	void feed_forward_layer(constant<layer_count>){
+	}
+	/**
+	 * Return the state of the optimizer for the weight at *weight_idx* in the array weights.
+	 * @param weight_idx The index of the weight.
+	 */
+	double* get_state(int const weight_idx){
+		return weights + layers::weight_count() + weight_idx * state_size;
+	}
+	/**
+	 * Propagate the errors of the layer layer_idx+1 to the layer layer_idx and adjust the weights between both, then go on with the previous layers.
+	 * @param layer_idx The index of the layer.
+	 */
+	template<int layer_idx>
+	void backpropagate_layer(constant<layer_idx>){
+		PerceptronKernel::backward<func>(weights + layers::weight_base(layer_idx+1), weights + layers::bias_base(layer_idx+1), neuron_output + layers::output_base(layer_idx),
+				neuron_output + layers::output_base(layer_idx+1), constant<layers::size(layer_idx+1)>(), constant<layers::size(layer_idx)>(), learning_rate,
+				static_cast<optimizer const&>(*this), get_state(layers::weight_base(layer_idx+1)), get_state(layers::bias_base(layer_idx+1)));
+		backpropagate_layer(constant<layer_idx-1>());
+	}
+	void backpropagate_layer(constant<-1>){
+	}
+	public:
+		/**
+		 * Constructor that randomly initializes the weights.
+		 * @param learning_rate The learning rate of the network.
+		 */
+		StaticMultiLayerPerceptron(double const learning_rate=0.1){
+			this->learning_rate = learning_rate;
+			for(int i = 0; i < layers::weight_count(); ++i)
+				weights[i] = func::random();
+			for(int i = layers::weight_count(); i < layers::weight_count() * (1 + state_size); ++i)
+				weights[i] = 0;
+		}
+		/**
+		 * Pass the input trough the neural network.
+		 * @param input The input value for the first layer of the neural network. Should be in the size of the first layer
+		 * @param output The result of the last layer. Should be in the size of the last layer.
+		 */
+		void feed_forward(double const* input, double* output){
+			for(int neuron_idx = 0; neuron_idx < input_size; ++neuron_idx)
+				neuron_output[neuron_idx] = input[neuron_idx];
+			feed_forward_layer(constant<1>());
+			double const* last_output = neuron_output + layers::output_base(layer_count-1);
+			for(int neuron_idx = 0; neuron_idx < output_size; ++neuron_idx)
+				output[neuron_idx] = last_output[neuron_idx];
+		}
+		/**
+		 * Change the optimizer, for instance to change its parameters. The state of the optimizer for each weight is kept.
+		 * @param new_optimizer The new optimizer.
+		 */
+		void set_optimizer(optimizer const& new_optimizer){
+			static_cast<optimizer&>(*this) = new_optimizer;
+		}
+		/**
+		 * Run the backpropagation step based on the expected value and the last call to feed_forward.
+		 * @param expected The expected output of the last layer.
+		 * @return The mean squared error of the output.
+		 */
+		double backpropagate(double const* expected){
+			double* last_output = neuron_output + layers::output_base(layer_count-1);
+			double sum_error_output = 0;
+			//Set the error of the last layer
+			for(int i = 0; i < output_size; ++i){
+				double const output = last_output[i];
+				double const err = output - expected[i];
+				sum_error_output += (err*err);
+				last_output[i] = func::derivative(output) * err;
+			}
+			optimizer::next_step();
+			backpropagate_layer(constant<layer_count-2>());
+			return (sum_error_output/output_size);
+		}
+		/**
+		 * Set the input weights of one neuron.
+		 * @param layer_idx The layer where the neuron is. Must be greater or equal to 1, because the first layer do not have weights.
+		 * @param neuron_idx The index of the neuron in this layer.
+		 * @param new_weights An array in the size of the previous layer plus one that contains the new weights. The last weight is for the bias.
+		 */
+		void set_weights(int layer_idx, int neuron_idx, double const* new_weights){
+			int const cols = layers::size(layer_idx-1);
+			double* row = weights + layers::weight_base(layer_idx) + neuron_idx * cols;
+			for(int i = 0; i < cols; ++i)
+				row[i] = new_weights[i];
+			weights[layers::bias_base(layer_idx) + neuron_idx] = new_weights[cols];
+		}
+		/**
+		 * Set the input weights of one layer.
+		 * @param layer_idx The layer where the neuron is. Must be greater or equal to 1, because the first layer do not have weights.
+		 * @param new_weights An array in the size of ((previous_layer_size+1) * current_layer) that contains the new weights.
+		 * The weights are given neuron after neuron, and the last weight of each neuron is for the bias.
+		 */
+		void set_weights(int layer_idx, double const* new_weights){
+			for(int neuron_idx = 0; neuron_idx < layers::size(layer_idx); ++neuron_idx)
+				set_weights(layer_idx, neuron_idx, new_weights + neuron_idx * (layers::size(layer_idx-1)+1));
+		}
+		/**
+		 * Set the input weights of the network.
+		 * @param new_weights An array that contains the new weights, layer after layer, as given to *set_weights* for one layer.
+		 */
+		void set_weights(double const* new_weights){
+			for(int l = 1; l < layer_count; ++l)
+				set_weights(l, new_weights + layers::weight_base(l));
+		}
+		/**
+		 * Return the array of weights.
+		 * Each layer is stored as a row-major matrix with one row per neuron, followed by the biases of the neurons.
+		 */
+		double* get_weights(void){
+			return weights;
+		}
+		/**
+		 * Return the number of weights of the network, including the biases.
+		 */
+		static constexpr int get_weight_count(void){
+			return layers::weight_count();
+		}
+};
@@ -0,0 +1,245 @@
+#pragma once
+#include <cstdint>
+#include "perceptron.hpp"
+/**
+ * Implement the inference of a trained MultiLayerPerceptron in fixed-point arithmetic.
+ * Each layer stores its weights as int8 values with one scale per layer, and its biases as int32 values in the scale of the accumulator.
+ * The outputs of each layer are int8 values with one scale per layer, so the linear combination of a neuron is an int8 dot product
+ * accumulated in an int32. The activation function is replaced by a lookup table indexed by the accumulator shifted right,
+ * which directly gives the int8 output of the neuron.
+ * The network is built by *quantize* from a MultiLayerPerceptron and calibration inputs, which give the range of the inputs and of the
+ * linear combinations of each layer.
+ * Templates:
+ * - layer_count: the number of layer.
+ * - max_size: the maximal size used by the weights, the biases, the outputs and the lookup tables, in bytes.
+ *   Like in MultiLayerPerceptron, the size and the scales of each layer are members of the class, outside of *max_size*.
+ * - table_size: the number of entries of the lookup table of each layer.
+ */
+template<int layer_count, int max_size, int table_size = 256>
+class QuantizedPerceptron{
+	//The limit of the int8 values, kept symmetric so zero is exact
+	static int const INT8_LIMIT = 127;
+	//The limit of the quantized biases, low enough to leave room for the dot product in the accumulator
+	static int const BIAS_LIMIT = 1 << 30;
+	//The biases of all layers (int32), followed by the weights of all layers (int8), the outputs of all layers (int8)
+	//and the lookup tables of the layers 1 to layer_count-1 (int8)
+	alignas(int32_t) char buffer[max_size];
+
+	//The size of each layer
+	int layer_size[layer_count];
+	//The index of the biases of each layer in the int32 biases, and of the weights and the outputs of each layer in the int8 arrays
+	int bias_base[layer_count];
+	int weight_base[layer_count];
+	int output_base[layer_count];
+	//The offsets of the weights, the outputs and the lookup tables in *buffer*, and the number of bytes used (0 until the network is quantized)
+	int weight_offset = 0, output_offset = 0, table_offset = 0, used_size = 0;
+	//The scale of the outputs of each layer: an output q stands for q * output_scale. The outputs of the layer 0 are the inputs.
+	double output_scale[layer_count];
+	//The right shift that turns the accumulator of a neuron into an index of the lookup table of its layer
+	int shift[layer_count];
+
+	int32_t* get_biases(int const layer_idx){
+		return reinterpret_cast<int32_t*>(buffer) + bias_base[layer_idx];
+	}
+	int8_t* get_weights(int const layer_idx){
+		return reinterpret_cast<int8_t*>(buffer + weight_offset) + weight_base[layer_idx];
+	}
+	int8_t* get_outputs(int const layer_idx){
+		return reinterpret_cast<int8_t*>(buffer + output_offset) + output_base[layer_idx];
+	}
+	/**
+	 * Return the lookup table of the activation function of a layer, from the layer 1. The entry i covers the accumulators
+	 * from (i-table_size/2) << shift to (i+1-table_size/2) << shift.
+	 * @param layer_idx The index of the layer.
+	 */
+	int8_t* get_table(int const layer_idx){
+		return reinterpret_cast<int8_t*>(buffer + table_offset) + (layer_idx - 1) * table_size;
+	}
+	/**
+	 * Round a value to the closest integer between -limit and limit.
+	 * @param value The value.
+	 * @param limit The limit.
+	 */
+	static int32_t quantize_value(double const value, int32_t const limit){
+		if(value >= limit)
+			return limit;
+		if(value <= -limit)
+			return -limit;
+		return static_cast<int32_t>(value >= 0 ? value + 0.5 : value - 0.5);
+	}
+	/**
+	 * Return the output of a neuron from the lookup table of its layer.
+	 * @param table The lookup table of the layer.
+	 * @param sum The accumulator of the neuron, bias included.
+	 * @param layer_shift The shift of the layer.
+	 */
+	static int8_t activate(int8_t const* table, int32_t const sum, int const layer_shift){
+		int32_t const index = (sum >> layer_shift) + table_size/2;
+		return table[index < 0 ? 0 : (index >= table_size ? table_size - 1 : index)];
+	}
+	public:
+	/**
+	 * Build the quantized network from a trained MultiLayerPerceptron.
+	 * The calibration inputs are passed through *network* to find the largest absolute input and the largest absolute linear combination
+	 * of each layer. The lookup table of a layer covers the linear combinations up to this value, and saturates beyond.
+	 * @param network The trained network. Its outputs are modified by the calibration.
+	 * @param calibration The calibration inputs, one after the other, in the size of the first layer.
+	 * @param count The number of calibration inputs, at least one.
+	 * @return False if there are no calibration inputs or if the network does not fit in *max_size*, in which case nothing is modified.
+	 */
+	template<int network_size, class func, class optimizer>
+	bool quantize(MultiLayerPerceptron<layer_count, network_size, func, optimizer>& network, double const* calibration, int const count){
+		int bias_count = 0, weight_count = 0, output_count = network.get_layer_size(0);
+		for(int l = 1; l < layer_count; ++l){
+			bias_count += network.get_layer_size(l);
+			weight_count += network.get_layer_size(l-1) * network.get_layer_size(l);
+			output_count += network.get_layer_size(l);
+		}
+		int const table_count = (layer_count - 1) * table_size;
+		int const size = sizeof(int32_t) * bias_count + weight_count + output_count + table_count;
+		if(count < 1 || size > max_size)
+			return false;
+		weight_offset = sizeof(int32_t) * bias_count;
+		output_offset = weight_offset + weight_count;
+		table_offset = output_offset + output_count;
+		used_size = size;
+
+		int const input_size = network.get_layer_size(0);
+		bias_base[0] = weight_base[0] = output_base[0] = 0;
+		for(int l = 0; l < layer_count; ++l){
+			layer_size[l] = network.get_layer_size(l);
+			if(l > 0){
+				bias_base[l] = (l > 1 ? bias_base[l-1] + layer_size[l-1] : 0);
+				weight_base[l] = (l > 1 ? weight_base[l-1] + layer_size[l-2] * layer_size[l-1] : 0);
+				output_base[l] = output_base[l-1] + layer_size[l-1];
+			}
+		}
+
+		//Calibration: the largest absolute input and linear combination of each layer. The maximums of the linear combinations
+		//are stored in *output_scale* until the tables are built.
+		double input_max = 0;
+		for(int i = 0; i < count * input_size; ++i){
+			double const value = (calibration[i] < 0 ? -calibration[i] : calibration[i]);
+			input_max = (value > input_max ? value : input_max);
+		}
+		for(int l = 0; l < layer_count; ++l)
+			output_scale[l] = 0;
+		for(int i = 0; i < count; ++i){
+			network.feed_forward(calibration + i * input_size, nullptr);
+			for(int l = 1; l < layer_count; ++l){
+				int const cols = layer_size[l-1];
+				double const* input = network.get_layer_output(l-1);
+				for(int r = 0; r < layer_size[l]; ++r){
+					double const* row = network.get_layer_weights(l) + r * cols;
+					double sum = network.get_layer_biases(l)[r];
+					for(int c = 0; c < cols; ++c)
+						sum += row[c] * input[c];
+					sum = (sum < 0 ? -sum : sum);
+					output_scale[l] = (sum > output_scale[l] ? sum : output_scale[l]);
+				}
+			}
+		}
+		output_scale[0] = (input_max > 0 ? input_max / INT8_LIMIT : 1);
+
+		for(int l = 1; l < layer_count; ++l){
+			int const rows = layer_size[l], cols = layer_size[l-1];
+			double const* weights = network.get_layer_weights(l);
+			double const* biases = network.get_layer_biases(l);
+			double const combination_max = output_scale[l];
+
+			//Weights and biases
+			double weight_max = 0;
+			for(int i = 0; i < rows * cols; ++i){
+				double const value = (weights[i] < 0 ? -weights[i] : weights[i]);
+				weight_max = (value > weight_max ? value : weight_max);
+			}
+			double const weight_scale = (weight_max > 0 ? weight_max / INT8_LIMIT : 1);
+			double const accumulator_scale = weight_scale * output_scale[l-1];
+			int8_t* quantized_weights = get_weights(l);
+			int32_t* quantized_biases = get_biases(l);
+			for(int i = 0; i < rows * cols; ++i)
+				quantized_weights[i] = static_cast<int8_t>(quantize_value(weights[i] / weight_scale, INT8_LIMIT));
+			for(int r = 0; r < rows; ++r)
+				quantized_biases[r] = quantize_value(biases[r] / accumulator_scale, BIAS_LIMIT);
+
+			//The smallest shift whose table covers the linear combinations up to their maximum
+			double const step = 2 * combination_max / (table_size * accumulator_scale);
+			shift[l] = 0;
+			while(shift[l] < 30 && static_cast<double>(1 << shift[l]) < step)
+				shift[l] += 1;
+
+			//The activation at the middle of each entry, then its int8 value in the scale of the layer
+			double const entry_width = static_cast<double>(1 << shift[l]) * accumulator_scale;
+			double activation_max = 0;
+			for(int i = 0; i < table_size; ++i){
+				double const activation = func::activation((i - table_size/2 + 0.5) * entry_width);
+				double const value = (activation < 0 ? -activation : activation);
+				activation_max = (value > activation_max ? value : activation_max);
+			}
+			output_scale[l] = (activation_max > 0 ? activation_max / INT8_LIMIT : 1);
+			int8_t* table = get_table(l);
+			for(int i = 0; i < table_size; ++i)
+				table[i] = static_cast<int8_t>(quantize_value(func::activation((i - table_size/2 + 0.5) * entry_width) / output_scale[l], INT8_LIMIT));
+		}
+		return true;
+	}
+	/**
+	 * Pass the input trough the quantized network. Nothing is done if the network has not been quantized yet.
+	 * @param input The input value for the first layer of the neural network. Should be in the size of the first layer
+	 * @param output The result of the last layer. Should be in the size of the last layer.
+	 */
+	void feed_forward(double const* input, double* output){
+		if(used_size == 0)
+			return;
+		int8_t* input_output = get_outputs(0);
+		double const input_factor = 1 / output_scale[0];
+		for(int i = 0; i < layer_size[0]; ++i)
+			input_output[i] = static_cast<int8_t>(quantize_value(input[i] * input_factor, INT8_LIMIT));
+
+		for(int l = 1; l < layer_count; ++l){
+			int const rows = layer_size[l], cols = layer_size[l-1];
+			int8_t const* weights = get_weights(l);
+			int32_t const* biases = get_biases(l);
+			int8_t const* previous = get_outputs(l-1);
+			int8_t* current = get_outputs(l);
+			int8_t const* table = get_table(l);
+			int const layer_shift = shift[l];
+			//Four rows at a time, so each input value is loaded once for four neurons
+			int const blocked_rows = rows - rows % 4;
+			for(int r = 0; r < blocked_rows; r += 4){
+				int8_t const* row0 = weights + r * cols;
+				int8_t const* row1 = row0 + cols;
+				int8_t const* row2 = row1 + cols;
+				int8_t const* row3 = row2 + cols;
+				int32_t sums[4] = {biases[r], biases[r+1], biases[r+2], biases[r+3]};
+				for(int c = 0; c < cols; ++c){
+					int32_t const x = previous[c];
+					sums[0] += row0[c] * x;
+					sums[1] += row1[c] * x;
+					sums[2] += row2[c] * x;
+					sums[3] += row3[c] * x;
+				}
+				for(int i = 0; i < 4; ++i)
+					current[r+i] = activate(table, sums[i], layer_shift);
+			}
+			for(int r = blocked_rows; r < rows; ++r){
+				int8_t const* row = weights + r * cols;
+				int32_t sum = biases[r];
+				for(int c = 0; c < cols; ++c)
+					sum += static_cast<int32_t>(row[c]) * static_cast<int32_t>(previous[c]);
+				current[r] = activate(table, sum, layer_shift);
+			}
+		}
+
+		int8_t const* last_output = get_outputs(layer_count-1);
+		double const last_scale = output_scale[layer_count-1];
+		for(int i = 0; i < layer_size[layer_count-1]; ++i)
+			output[i] = last_output[i] * last_scale;
+	}
+	/**
+	 * Return the number of bytes used by the weights, the biases, the outputs and the lookup tables of the network.
+	 */
+	int get_used_size(void) const{
+		return used_size;
+	}
+};
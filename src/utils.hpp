@@ -1,3 +1,54 @@
+#pragma once
+#include <stdint.h>
+/**
+ * Random generator that calls the rand_uniform function of *func*.
+ * It lets the code that takes a random generator object use the global random function of the caller.
+ * Templates:
+ * - func: a class type with a static rand_uniform function that pick uniformly a random number between [0,1[.
+ */
+template<class func>
+class FuncRandom{
+	public:
+	double rand_uniform(void){
+		return func::rand_uniform();
+	}
+};
+/**
+ * Xorshift64* random generator. Unlike a global random function, each generator holds its own state,
+ * so several threads can each use their own generator, and a seed gives the same sequence on every run.
+ */
+class XorShiftRandom{
+	uint64_t state;
+	public:
+	/**
+	 * Constructor.
+	 * @param seed The seed of the generator. Two different seeds give two unrelated sequences.
+	 */
+	XorShiftRandom(uint64_t const seed = 0){
+		//Scramble the seed with SplitMix64 so that close seeds give unrelated states, and the state is never zero
+		uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		z = z ^ (z >> 31);
+		state = (z != 0 ? z : 0x9E3779B97F4A7C15ULL);
+	}
+	/**
+	 * Return a random 64-bit integer.
+	 */
+	uint64_t next(void){
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 0x2545F4914F6CDD1DULL;
+	}
+	/**
+	 * Uniformly pick a random number between [0,1[.
+	 */
+	double rand_uniform(void){
+		//The 53 highest bits fill the mantissa of a double
+		return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+};
 class Utils{
 	public:
 	/**
@@ -11,7 +62,20 @@ class Utils{
 	 */
 	template<class func>
 	static int pick_from_distribution(double const*const probabilities, const int size){
-		double const u = func::rand_uniform(); //Sample a random number between [0,1[
+		FuncRandom<func> generator;
+		return pick_from_distribution(probabilities, size, generator);
+	}
+	/**
+	 * Same as *pick_from_distribution* but the random number is picked by *generator*.
+	 * Templates:
+	 * - random: a random generator with a rand_uniform method that pick uniformly a random number between [0,1[ (e.g., FuncRandom, XorShiftRandom).
+	 * @param probabilities An array that contains the distribution of probabilities. The final value of the index should be equal to 1.
+	 * @param size The size of the array *probabilities*.
+	 * @param generator The random generator.
+	 */
+	template<class random>
+	static int pick_from_distribution(double const*const probabilities, const int size, random& generator){
+		double const u = generator.rand_uniform(); //Sample a random number between [0,1[
 		//NOTE improve with a log search :]
 		for(int i = 0; i < size; ++i){
 			if(u <= probabilities[i])
@@ -59,7 +123,17 @@ class Utils{
 	}
 	template<class func>
 	static double rand_exponential(double const rate){
-		double const u = func::rand_uniform(); //Sample a random number between [0,1[
+		FuncRandom<func> generator;
+		return rand_exponential<func>(rate, generator);
+	}
+	/**
+	 * Same as *rand_exponential* but the uniform random number is picked by *generator*.
+	 * @param rate The lambda parameter
+	 * @param generator The random generator.
+	 */
+	template<class func, class random>
+	static double rand_exponential(double const rate, random& generator){
+		double const u = generator.rand_uniform(); //Sample a random number between [0,1[
 		return func::log(1-u) / (-rate); //turn it into the exponential distribution
 	}
 	//An inline function that compute the minimum between two numbers
@@ -0,0 +1,111 @@
+#include <cmath>
+#include <cstdlib>
+#include "gtest/gtest.h"
+#include "drift_detection.hpp"
+
+namespace DriftDetectionTest{
+class functions{
+	public:
+	static double log(double const x){
+		return std::log(x);
+	}
+	static double sqrt(double const x){
+		return std::sqrt(x);
+	}
+};
+/**
+ * Feed *detector* with errors drawn with an error rate of *before* for *change* errors, then *after* for *count-change* errors.
+ * Return the index of the first drift detected after *change*, or -1 if there is none. *false_alarms* counts the drifts detected before *change*.
+ */
+template<class detector_type>
+int first_drift(detector_type& detector, int const count, int const change, double const before, double const after, int& false_alarms){
+	false_alarms = 0;
+	srand(42);
+	for(int i = 0; i < count; ++i){
+		double const rate = (i < change ? before : after);
+		double const error = ((rand() % 1000) < rate * 1000 ? 1 : 0);
+		if(detector.update(error)){
+			if(i < change)
+				false_alarms += 1;
+			else
+				return i;
+		}
+	}
+	return -1;
+}
+
+TEST(DriftDetection, no_drift) { 
+	NoDriftDetection<functions> detector;
+	int false_alarms;
+	EXPECT_EQ(-1, first_drift(detector, 2000, 1000, 0.1, 0.9, false_alarms));
+	EXPECT_FALSE(NoDriftDetection<functions>::detects_drift);
+}
+TEST(DriftDetection, page_hinkley) { 
+	PageHinkley<functions> detector;
+	int false_alarms;
+	int const drift = first_drift(detector, 20000, 10000, 0.1, 0.6, false_alarms);
+	EXPECT_EQ(0, false_alarms);
+	EXPECT_TRUE(drift >= 10000 && drift < 10500);
+}
+TEST(DriftDetection, ddm) { 
+	//The minimum of DDM is unreliable with few errors, which causes false alarms at the beginning of the stream
+	DDM<functions> detector(2, 3, 1000);
+	int false_alarms;
+	int const drift = first_drift(detector, 20000, 10000, 0.1, 0.6, false_alarms);
+	EXPECT_EQ(0, false_alarms);
+	EXPECT_TRUE(drift >= 10000 && drift < 10500);
+}
+TEST(DriftDetection, ddm_warning) { 
+	/*
+	 * A small increase of the error rate raises a warning before the drift.
+	 */
+	DDM<functions> detector;
+	srand(42);
+	bool warned = false;
+	for(int i = 0; i < 20000; ++i){
+		double const rate = (i < 10000 ? 0.1 : 0.2);
+		if(detector.update((rand() % 1000) < rate * 1000 ? 1 : 0))
+			break;
+		warned = warned || detector.is_warning();
+	}
+	EXPECT_TRUE(warned);
+}
+TEST(DriftDetection, adwin) { 
+	ADWIN<functions> detector;
+	int false_alarms;
+	int const drift = first_drift(detector, 20000, 10000, 0.1, 0.6, false_alarms);
+	EXPECT_EQ(0, false_alarms);
+	EXPECT_TRUE(drift >= 10000 && drift < 10500);
+	//The window should have dropped the errors from before the drift
+	EXPECT_TRUE(detector.get_width() < 1000);
+	for(int i = 0; i < 1000; ++i)
+		detector.update((rand() % 1000) < 600 ? 1 : 0);
+	EXPECT_NEAR(0.6, detector.get_mean(), 0.05);
+}
+TEST(DriftDetection, adwin_statistics) { 
+	/*
+	 * Without drift, the window keeps every error and its statistics are exact.
+	 */
+	ADWIN<functions> detector;
+	double const errors[8] = {0, 1, 0, 0, 1, 0, 0, 0};
+	for(int i = 0; i < 1000; ++i)
+		EXPECT_FALSE(detector.update(errors[i % 8]));
+	EXPECT_EQ(1000, detector.get_width());
+	EXPECT_NEAR(0.25, detector.get_mean(), 1e-9);
+	EXPECT_NEAR(0.1875, detector.get_variance(), 1e-9);
+	detector.reset();
+	EXPECT_EQ(0, detector.get_width());
+}
+TEST(DriftDetection, adwin_bounded_window) { 
+	/*
+	 * With 2 buckets on 4 levels, the window holds at most 2*(1+2+4+8) errors.
+	 */
+	ADWIN<functions, 2, 4> detector;
+	for(int i = 0; i < 10000; ++i){
+		detector.update(0.5);
+		EXPECT_TRUE(detector.get_width() <= 30);
+	}
+	EXPECT_TRUE(detector.get_width() > 15);
+	EXPECT_NEAR(0.5, detector.get_mean(), 1e-9);
+}
+}
@@ -80,4 +80,203 @@ TEST(HoeffdingTree, is_leaf2) {
 	ht.train(&dt[0][0], labels[0]);
 	EXPECT_EQ (false, root->is_leaf()); //A split should have occured so root should not be a leaf anymore
 }
+TEST(HoeffdingTree, learn_threshold) { 
+	/*
+	 * The label only depends on the first feature, so the tree should split on it and predict both sides correctly.
+	 */
+	int features_size[2] = {4, 4};
+	HoeffdingTree<double, 2, 2, 100000, functions> ht(0.01, features_size);
+	auto root = ht.get_root();
+	double new_limits[6] = {2.5, 5, 7.5, 2.5, 5, 7.5};
+	root->set_limits(new_limits);
+	srand(42);
+	for(int i = 0; i < 2000; ++i){
+		double point[2] = {(rand() % 1000) / 100.0, (rand() % 1000) / 100.0};
+		ht.train(point, (point[0] < 5 ? 0 : 1));
+	}
+	EXPECT_FALSE(root->is_leaf());
+	double low[2] = {1, 5}, high[2] = {9, 5};
+	EXPECT_EQ(0, ht.predict(low));
+	EXPECT_EQ(1, ht.predict(high));
+}
+TEST(HoeffdingTree, grace_period) { 
+	/*
+	 * With a grace period, the splits are only evaluated every *grace_period* data points.
+	 */
+	int features_size[2] = {3, 2};
+	HoeffdingTree<double, 2, 2, 10000, functions> ht(0.3, features_size, 200);
+	EXPECT_EQ(200, ht.get_grace_period());
+	auto root = ht.get_root();
+
+	double new_limits[3] = {0.5, 1.5, 0.5};
+	root->set_limits(new_limits);
+	for(int i = 0; i < 100*COUNT_ENTRY_HT; ++i){
+		double split_value;
+		int const result = root->train(&dt[i%COUNT_ENTRY_HT][0], labels[i%COUNT_ENTRY_HT], split_value);
+		if((i+1) % 200 != 0)
+			EXPECT_EQ(-1, result);
+	}
+	//The info gain is the same whether it is evaluated at every data point or not
+	double info_gain[3];
+	root->compute_information_gain(info_gain);
+	std::sort(info_gain, info_gain+3);	
+	ASSERT_NEAR(info_gain[0], 0.003184, 0.0001);
+	ASSERT_NEAR(info_gain[1], 0.048127, 0.0001);
+	ASSERT_NEAR(info_gain[2], 0.102243, 0.0001);
+
+	ht.set_grace_period(1);
+	ht.train(&dt[0][0], labels[0]);
+	EXPECT_FALSE(root->is_leaf());
+}
+TEST(HoeffdingTree, tie_threshold) { 
+	/*
+	 * Both features are identical, so their splits are tied and only the tie threshold can make the leaf split.
+	 */
+	int features_size[2] = {4, 4};
+	double new_limits[6] = {2.5, 5, 7.5, 2.5, 5, 7.5};
+	HoeffdingTree<double, 2, 2, 100000, functions> tied(0.01, features_size);
+	HoeffdingTree<double, 2, 2, 100000, functions> ht(0.01, features_size);
+	EXPECT_EQ(0, tied.get_tie_threshold());
+	ht.set_tie_threshold(0.05);
+	EXPECT_NEAR(0.05, ht.get_tie_threshold(), 1e-9);
+	EXPECT_NEAR(1, ht.get_gain_range(), 1e-9);
+	tied.get_root()->set_limits(new_limits);
+	ht.get_root()->set_limits(new_limits);
+	srand(42);
+	for(int i = 0; i < 2000; ++i){
+		double const value = (rand() % 1000) / 100.0;
+		double point[2] = {value, value};
+		tied.train(point, (value < 5 ? 0 : 1));
+		ht.train(point, (value < 5 ? 0 : 1));
+	}
+	EXPECT_TRUE(tied.get_root()->is_leaf());
+	EXPECT_FALSE(ht.get_root()->is_leaf());
+	double low[2] = {1, 1}, high[2] = {9, 9};
+	EXPECT_EQ(0, ht.predict(low));
+	EXPECT_EQ(1, ht.predict(high));
+}
+TEST(HoeffdingTree, gaussian_observer) { 
+	/*
+	 * The Gaussian observer does not need limits from the user: the candidate splits follow the data seen by the leaf.
+	 */
+	int features_size[2] = {8, 8};
+	HoeffdingTree<double, 2, 2, 100000, functions, HoeffdingGaussianObserver<2, functions>> ht(0.01, features_size, 50);
+	srand(42);
+	for(int i = 0; i < 2000; ++i){
+		double point[2] = {(rand() % 1000) / 100.0, (rand() % 1000) / 100.0};
+		ht.train(point, (point[0] < 5 ? 0 : 1));
+	}
+	EXPECT_FALSE(ht.get_root()->is_leaf());
+	double low[2] = {1, 5}, high[2] = {9, 5};
+	EXPECT_EQ(0, ht.predict(low));
+	EXPECT_EQ(1, ht.predict(high));
+}
+TEST(HoeffdingTree, gaussian_observer_memory) { 
+	/*
+	 * The leaves of the Gaussian observer store neither limits nor information gains, so many bins still fit in a small buffer.
+	 */
+	int features_size[2] = {64, 64};
+	//The neighbouring candidate splits of the first feature have close gains, so the tie threshold is needed to split
+	HoeffdingTree<double, 2, 2, 4000, functions, HoeffdingGaussianObserver<2, functions>> ht(0.01, features_size, 50, 0.05);
+	srand(42);
+	for(int i = 0; i < 2000; ++i){
+		double point[2] = {(rand() % 1000) / 100.0, (rand() % 1000) / 100.0};
+		ht.train(point, (point[0] < 5 ? 0 : 1));
+	}
+	EXPECT_FALSE(ht.get_root()->is_leaf());
+	EXPECT_EQ(0, ht.count_inactive_leaves());
+	double low[2] = {1, 5}, high[2] = {9, 5};
+	EXPECT_EQ(0, ht.predict(low));
+	EXPECT_EQ(1, ht.predict(high));
+}
+TEST(HoeffdingTree, memory_budget) { 
+	/*
+	 * The buffer is too small for the tree this dataset needs.
+	 * The tree should deactivate the least promising leaves to keep splitting the others instead of running out of memory.
+	 */
+	int features_size[2] = {8, 8};
+	HoeffdingTree<double, 2, 2, 4000, functions, HoeffdingGaussianObserver<2, functions>> ht(0.01, features_size, 50, 0.05, 1000);
+	srand(42);
+	for(int i = 0; i < 50000; ++i){
+		double point[2] = {(rand() % 1000) / 100.0, (rand() % 1000) / 100.0};
+		ht.train(point, (std::fmod(point[0], 2.0) < 1 ? 0 : 1));
+	}
+	EXPECT_TRUE(ht.count_inactive_leaves() > 0);
+	int correct = 0;
+	for(int i = 0; i < 1000; ++i){
+		double point[2] = {(rand() % 1000) / 100.0, (rand() % 1000) / 100.0};
+		correct += (ht.predict(point) == (std::fmod(point[0], 2.0) < 1 ? 0 : 1));
+	}
+	EXPECT_TRUE(correct > 900);
+}
+TEST(HoeffdingTree, memory_size) { 
+	/*
+	 * The routing nodes come out of the memory of the tree, so the tree grows with *max_size* and not more.
+	 */
+	typedef HoeffdingTree<double, 2, 2, 4000, functions> Small;
+	typedef HoeffdingTree<double, 2, 2, 8000, functions> Large;
+	//The arrays may be padded differently
+	EXPECT_LE(sizeof(Large) - sizeof(Small), 4000 + sizeof(double));
+}
+TEST(HoeffdingTree, predict_batch) { 
+	/*
+	 * Predicting by batch should give the same labels and scores as predicting one data point at a time.
+	 */
+	int features_size[2] = {8, 8};
+	HoeffdingTree<double, 2, 2, 100000, functions, HoeffdingGaussianObserver<2, functions>> ht(0.01, features_size, 50);
+	srand(42);
+	for(int i = 0; i < 5000; ++i){
+		double point[2] = {(rand() % 1000) / 100.0, (rand() % 1000) / 100.0};
+		ht.train(point, (std::fmod(point[0], 2.0) < 1 ? 0 : 1));
+	}
+	int const count = 150;
+	double points[count][2];
+	for(int i = 0; i < count; ++i){
+		points[i][0] = (rand() % 1000) / 100.0;
+		points[i][1] = (rand() % 1000) / 100.0;
+	}
+	int labels[count];
+	double scores[count][2];
+	ht.predict_batch(&points[0][0], count, labels, &scores[0][0]);
+	for(int i = 0; i < count; ++i){
+		double expected_scores[2];
+		EXPECT_EQ(ht.predict(points[i]), labels[i]);
+		EXPECT_EQ(ht.predict(points[i], expected_scores), labels[i]);
+		EXPECT_EQ(expected_scores[0], scores[i][0]);
+		EXPECT_EQ(expected_scores[1], scores[i][1]);
+	}
+}
+TEST(HoeffdingTree, adaptation_size) { 
+	/*
+	 * Only the nodes of an adaptive tree pay for the drift detector and the alternate subtree.
+	 */
+	typedef HoeffdingTree<double, 2, 2, 10000, functions> Static;
+	typedef HoeffdingTree<double, 2, 2, 10000, functions, HoeffdingBinObserver<2>, PageHinkley<functions>> Adaptive;
+	EXPECT_GE(sizeof(Adaptive::Node), sizeof(Static::Node) + sizeof(PageHinkley<functions>) + 4 * sizeof(int));
+}
+TEST(HoeffdingTree, concept_drift) { 
+	/*
+	 * The labels are swapped after 10000 data points, which the leaves of a static tree only learn once their majority label changes.
+	 * The adaptive tree should detect the drift, grow an alternate subtree and replace the outdated one.
+	 */
+	int features_size[2] = {8, 8};
+	HoeffdingTree<double, 2, 2, 200000, functions, HoeffdingGaussianObserver<2, functions>> ht(0.01, features_size, 50);
+	HoeffdingTree<double, 2, 2, 200000, functions, HoeffdingGaussianObserver<2, functions>, PageHinkley<functions>> adaptive(0.01, features_size, 50);
+	srand(42);
+	for(int i = 0; i < 14000; ++i){
+		double point[2] = {(rand() % 1000) / 100.0, (rand() % 1000) / 100.0};
+		int const label = (i < 10000 ? (point[0] < 5 ? 0 : 1) : (point[0] < 5 ? 1 : 0));
+		ht.train(point, label);
+		adaptive.train(point, label);
+	}
+	int correct = 0, adaptive_correct = 0;
+	for(int i = 0; i < 1000; ++i){
+		double point[2] = {(rand() % 1000) / 100.0, (rand() % 1000) / 100.0};
+		int const label = (point[0] < 5 ? 1 : 0);
+		correct += (ht.predict(point) == label);
+		adaptive_correct += (adaptive.predict(point) == label);
+	}
+	EXPECT_TRUE(adaptive_correct > 950);
+	EXPECT_TRUE(adaptive_correct > correct);
+}
 }
@@ -91,3 +91,98 @@ TEST(MCNN, split) {
 	for(int idx = 0; idx < 13; ++idx)
 		EXPECT_EQ(labels[idx], classifier.predict(dataset[idx]));
 }
+TEST(MCNN, cleaning) { 
+	/*
+	 * A cluster that stops receiving data points should be removed once its participation drops below the threshold.
+	 */
+	MCNN<int, 2, 4> classifier(2, 1, 50);
+	int old_point[2] = {0, 0};
+	int new_point[2] = {100, 100};
+	classifier.train(old_point, 0);
+	classifier.train(old_point, 0);
+	EXPECT_EQ(1, classifier.count_clusters());
+	for(int i = 0; i < 50; ++i)
+		classifier.train(new_point, 1);
+	EXPECT_EQ(1, classifier.count_clusters());
+	EXPECT_EQ(1, classifier.predict(old_point));
+	//The freed slot can be used again
+	classifier.train(old_point, 0);
+	EXPECT_EQ(2, classifier.count_clusters());
+	EXPECT_EQ(0, classifier.predict(old_point));
+}
+TEST(MCNN, eviction) { 
+	/*
+	 * When every cluster is used, a new class replaces an existing cluster instead of being dropped.
+	 */
+	MCNN<int, 2, 3> classifier(2, 0, 50);
+	for(int label = 0; label < 6; ++label){
+		int point[2] = {label * 10, 0};
+		EXPECT_TRUE(classifier.train(point, label));
+		EXPECT_EQ(label, classifier.predict(point));
+		EXPECT_TRUE(classifier.count_clusters() <= 3);
+	}
+	EXPECT_EQ(3, classifier.count_clusters());
+}
+TEST(MCNN, split_float_offset) { 
+	/*
+	 * Same scenario as the split test, but with float features far from zero.
+	 * The variance must stay accurate so the split is done on the first feature.
+	 */
+	int const dataset_size = 13;
+	float const offset = 1000000;
+	MCNN<float, 4> classifier;
+	float dataset[dataset_size][4];
+	int labels[dataset_size];
+	for(int i = 0; i < dataset_size; ++i){
+		labels[i] = 0;
+		for(int j = 0; j < 4; ++j)
+			dataset[i][j] = offset;
+	}
+	dataset[1][0] = offset + 30;
+	labels[1] = 1;
+	for(int idx = 2; idx < 13; ++idx)
+		dataset[idx][0] = offset + 21;
+
+	for(int idx = 0; idx < 13; ++idx)
+		classifier.train(dataset[idx], labels[idx]);	
+	EXPECT_TRUE(classifier.count_clusters() > 2);
+	for(int idx = 0; idx < 13; ++idx)
+		EXPECT_EQ(labels[idx], classifier.predict(dataset[idx]));
+}
+TEST(MCNN, eviction_lowest_participation) { 
+	/*
+	 * The evicted cluster is the one with the lowest participation, even when another cluster crossed the threshold earlier.
+	 */
+	MCNN<int, 1, 3> classifier(100, 0, 50);
+	int a[1] = {0}, b[1] = {100}, c[1] = {200}, d[1] = {300};
+	for(int i = 0; i < 4; ++i)
+		classifier.train(a, 0);
+	classifier.train(b, 1);
+	for(int i = 0; i < 4; ++i)
+		classifier.train(c, 2);
+	//Participation of a: 600/45, b: 400/35, c: 2600/30
+	EXPECT_TRUE(classifier.train(d, 3));
+	EXPECT_EQ(3, classifier.count_clusters());
+	EXPECT_EQ(0, classifier.predict(a));
+	EXPECT_EQ(2, classifier.predict(c));
+	EXPECT_EQ(3, classifier.predict(d));
+}
+TEST(MCNN, eviction_overtaken_participation) { 
+	/*
+	 * The participation of the clusters decreases at different speeds, so the cluster with the lowest participation changes as time passes.
+	 */
+	MCNN<int, 1, 3> classifier(100, 0, 50);
+	int a[1] = {0}, b[1] = {100}, c[1] = {200}, d[1] = {300};
+	for(int i = 0; i < 4; ++i)
+		classifier.train(a, 0);
+	classifier.train(b, 1);
+	//At the timestamp 5, a has the lowest participation (600/15 against 400/5 for b)
+	for(int i = 0; i < 3; ++i)
+		classifier.train(c, 2);
+	//At the timestamp 8, b has the lowest participation: 400/26 against 600/36 for a and 1800/21 for c
+	EXPECT_TRUE(classifier.train(d, 3));
+	EXPECT_EQ(3, classifier.count_clusters());
+	EXPECT_EQ(0, classifier.predict(a));
+	EXPECT_EQ(2, classifier.predict(c));
+	EXPECT_EQ(3, classifier.predict(d));
+}
@@ -0,0 +1,217 @@
+#include "gtest/gtest.h"
+#include <cstdlib>
+#include <cmath>
+using namespace std;
+#include "mondrian.hpp"
+#include "mondrian_unbound.hpp"
+#include "mondrian_coarse.hpp"
+
+namespace MondrianTest{
+class functions{
+	public:
+	static double exp(double const x){
+		return std::exp(x);
+	}
+	static double log(double const x){
+		return std::log(x);
+	}
+	static double rand_uniform(void){
+		return static_cast<double>(rand()) / (static_cast<double>(RAND_MAX) + 1);
+	}
+};
+#define MONDRIAN_FEATURE_COUNT 3
+#define MONDRIAN_LABEL_COUNT 3
+#define MONDRIAN_TREE_COUNT 4
+#define MONDRIAN_POINT_COUNT 300
+//Three clusters of data points, one per label, with some noise
+void generate(double* features, int* labels, int const count){
+	XorShiftRandom generator(42);
+	for(int i = 0; i < count; ++i){
+		labels[i] = i % MONDRIAN_LABEL_COUNT;
+		for(int j = 0; j < MONDRIAN_FEATURE_COUNT; ++j)
+			features[i * MONDRIAN_FEATURE_COUNT + j] = labels[i] * (j + 1) + 2 * generator.rand_uniform();
+	}
+}
+typedef MondrianForest<double, functions, MONDRIAN_TREE_COUNT, MONDRIAN_FEATURE_COUNT, MONDRIAN_LABEL_COUNT, 1000000> Bounded;
+typedef MondrianForestUnbound<double, functions, MONDRIAN_FEATURE_COUNT, MONDRIAN_LABEL_COUNT> Unbound;
+typedef CoarseMondrianForest<double, functions, KappaMetrics<MONDRIAN_LABEL_COUNT>, MONDRIAN_FEATURE_COUNT, MONDRIAN_LABEL_COUNT, 100000> Coarse;
+/**
+ * Train a forest, then check that *predict_batch* with one thread and with *thread_count* threads gives the labels of *predict*,
+ * and the same posterior means.
+ */
+template<class forest_type>
+void expect_same_batch_prediction(forest_type& forest, int const thread_count){
+	double features[MONDRIAN_POINT_COUNT * MONDRIAN_FEATURE_COUNT];
+	int labels[MONDRIAN_POINT_COUNT];
+	generate(features, labels, MONDRIAN_POINT_COUNT);
+	for(int i = 0; i < MONDRIAN_POINT_COUNT; ++i)
+		forest.train(features + i * MONDRIAN_FEATURE_COUNT, labels[i]);
+	int single_labels[MONDRIAN_POINT_COUNT], split_labels[MONDRIAN_POINT_COUNT];
+	double single_scores[MONDRIAN_POINT_COUNT * MONDRIAN_LABEL_COUNT], split_scores[MONDRIAN_POINT_COUNT * MONDRIAN_LABEL_COUNT];
+	forest.predict_batch(features, MONDRIAN_POINT_COUNT, single_labels, single_scores, 1);
+	forest.predict_batch(features, MONDRIAN_POINT_COUNT, split_labels, split_scores, thread_count);
+	for(int i = 0; i < MONDRIAN_POINT_COUNT; ++i){
+		int const label = forest.predict(features + i * MONDRIAN_FEATURE_COUNT);
+		EXPECT_EQ(label, single_labels[i]);
+		EXPECT_EQ(label, split_labels[i]);
+		for(int k = 0; k < MONDRIAN_LABEL_COUNT; ++k)
+			EXPECT_EQ(single_scores[i * MONDRIAN_LABEL_COUNT + k], split_scores[i * MONDRIAN_LABEL_COUNT + k]);
+	}
+}
+/**
+ * Train two forests, the first one with one batch and one thread, the second one with two batches and *thread_count* threads,
+ * then check that they predict the same posterior means.
+ */
+template<class forest_type>
+void expect_same_batch_training(forest_type& single, forest_type& split, int const thread_count){
+	double features[MONDRIAN_POINT_COUNT * MONDRIAN_FEATURE_COUNT];
+	int labels[MONDRIAN_POINT_COUNT];
+	generate(features, labels, MONDRIAN_POINT_COUNT);
+	int const half = MONDRIAN_POINT_COUNT / 2;
+	EXPECT_TRUE(single.train_batch(features, labels, MONDRIAN_POINT_COUNT, 1));
+	EXPECT_TRUE(split.train_batch(features, labels, half, thread_count));
+	EXPECT_TRUE(split.train_batch(features + half * MONDRIAN_FEATURE_COUNT, labels + half, MONDRIAN_POINT_COUNT - half, thread_count));
+	int single_labels[MONDRIAN_POINT_COUNT], split_labels[MONDRIAN_POINT_COUNT];
+	double single_scores[MONDRIAN_POINT_COUNT * MONDRIAN_LABEL_COUNT], split_scores[MONDRIAN_POINT_COUNT * MONDRIAN_LABEL_COUNT];
+	single.predict_batch(features, MONDRIAN_POINT_COUNT, single_labels, single_scores);
+	split.predict_batch(features, MONDRIAN_POINT_COUNT, split_labels, split_scores);
+	for(int i = 0; i < MONDRIAN_POINT_COUNT; ++i){
+		EXPECT_EQ(single_labels[i], split_labels[i]);
+		for(int k = 0; k < MONDRIAN_LABEL_COUNT; ++k)
+			EXPECT_DOUBLE_EQ(single_scores[i * MONDRIAN_LABEL_COUNT + k], split_scores[i * MONDRIAN_LABEL_COUNT + k]);
+	}
+}
+TEST(MondrianForest, train_batch_threads) {
+	Bounded* single = new Bounded(1.0, 1.0 / MONDRIAN_LABEL_COUNT, -1);
+	Bounded* split = new Bounded(1.0, 1.0 / MONDRIAN_LABEL_COUNT, -1);
+	expect_same_batch_training(*single, *split, 3);
+	delete single;
+	delete split;
+}
+TEST(MondrianForestUnbound, train_batch_threads) {
+	Unbound single(1.0, 1.0 / MONDRIAN_LABEL_COUNT, -1, MONDRIAN_TREE_COUNT);
+	Unbound split(1.0, 1.0 / MONDRIAN_LABEL_COUNT, -1, MONDRIAN_TREE_COUNT);
+	expect_same_batch_training(single, split, 3);
+}
+TEST(MondrianForest, predict_batch_threads) {
+	Bounded* forest = new Bounded(1.0, 1.0 / MONDRIAN_LABEL_COUNT, -1);
+	expect_same_batch_prediction(*forest, 3);
+	delete forest;
+}
+TEST(MondrianForestUnbound, predict_batch_threads) {
+	Unbound forest(1.0, 1.0 / MONDRIAN_LABEL_COUNT, -1, MONDRIAN_TREE_COUNT);
+	expect_same_batch_prediction(forest, 3);
+}
+TEST(CoarseMondrianForest, predict_batch_threads) {
+	Coarse* forest = new Coarse(1.0, 1.0 / MONDRIAN_LABEL_COUNT, -1, MONDRIAN_TREE_COUNT);
+	expect_same_batch_prediction(*forest, 3);
+	delete forest;
+}
+TEST(MondrianForest, cached_posterior_means) {
+	//The cache changes the size of the nodes, so the budget holds all the nodes with or without it
+	typedef MondrianForest<double, functions, MONDRIAN_TREE_COUNT, MONDRIAN_FEATURE_COUNT, MONDRIAN_LABEL_COUNT, 1000000, true> Cached;
+	Bounded* forest = new Bounded(1.0, 1.0 / MONDRIAN_LABEL_COUNT, -1);
+	Cached* cached = new Cached(1.0, 1.0 / MONDRIAN_LABEL_COUNT, -1);
+	double features[MONDRIAN_POINT_COUNT * MONDRIAN_FEATURE_COUNT];
+	int labels[MONDRIAN_POINT_COUNT];
+	generate(features, labels, MONDRIAN_POINT_COUNT);
+	//Alternate the predictions and the training, so the cache is outdated by each data point
+	for(int i = 0; i < MONDRIAN_POINT_COUNT; ++i){
+		int forest_labels[MONDRIAN_POINT_COUNT], cached_labels[MONDRIAN_POINT_COUNT];
+		double forest_scores[MONDRIAN_POINT_COUNT * MONDRIAN_LABEL_COUNT], cached_scores[MONDRIAN_POINT_COUNT * MONDRIAN_LABEL_COUNT];
+		forest->predict_batch(features, i + 1, forest_labels, forest_scores);
+		cached->predict_batch(features, i + 1, cached_labels, cached_scores);
+		for(int j = 0; j <= i; ++j){
+			EXPECT_EQ(forest_labels[j], cached_labels[j]);
+			for(int k = 0; k < MONDRIAN_LABEL_COUNT; ++k)
+				EXPECT_EQ(forest_scores[j * MONDRIAN_LABEL_COUNT + k], cached_scores[j * MONDRIAN_LABEL_COUNT + k]);
+		}
+		forest->train_batch(features + i * MONDRIAN_FEATURE_COUNT, labels + i, 1);
+		cached->train_batch(features + i * MONDRIAN_FEATURE_COUNT, labels + i, 1);
+	}
+	delete forest;
+	delete cached;
+}
+TEST(CoarseMondrianForest, cached_posterior_means) {
+	//The trees grow with the original extend, and the cache changes the size of the nodes, so the budget holds all the nodes with or without it
+	typedef MondrianNode<MONDRIAN_FEATURE_COUNT, MONDRIAN_LABEL_COUNT> Node;
+	typedef StaticMondrianStrategy<ROBUR_MANAGEMENT, FE_DISTRIBUTION_ZERO, SPLIT_TRIGGER_NONE, SPLIT_HELPER_NONE, EXTEND_ORIGINAL> Growing;
+	typedef CoarseMondrianForest<double, functions, KappaMetrics<MONDRIAN_LABEL_COUNT>, MONDRIAN_FEATURE_COUNT, MONDRIAN_LABEL_COUNT, 1000000, Node, Growing> Large;
+	typedef CoarseMondrianForest<double, functions, KappaMetrics<MONDRIAN_LABEL_COUNT>, MONDRIAN_FEATURE_COUNT, MONDRIAN_LABEL_COUNT, 1000000, Node, Growing, true> Cached;
+	Large* forest = new Large(1.0, 1.0 / MONDRIAN_LABEL_COUNT, -1, MONDRIAN_TREE_COUNT);
+	Cached* cached = new Cached(1.0, 1.0 / MONDRIAN_LABEL_COUNT, -1, MONDRIAN_TREE_COUNT);
+	double features[MONDRIAN_POINT_COUNT * MONDRIAN_FEATURE_COUNT];
+	int labels[MONDRIAN_POINT_COUNT];
+	generate(features, labels, MONDRIAN_POINT_COUNT);
+	//Alternate the predictions and the training, so the cache is outdated by each data point
+	for(int i = 0; i < MONDRIAN_POINT_COUNT; ++i){
+		int forest_labels[MONDRIAN_POINT_COUNT], cached_labels[MONDRIAN_POINT_COUNT];
+		double forest_scores[MONDRIAN_POINT_COUNT * MONDRIAN_LABEL_COUNT], cached_scores[MONDRIAN_POINT_COUNT * MONDRIAN_LABEL_COUNT];
+		forest->predict_batch(features, i + 1, forest_labels, forest_scores);
+		//The threads read the cache filled before them
+		cached->predict_batch(features, i + 1, cached_labels, cached_scores, 3);
+		for(int j = 0; j <= i; ++j){
+			EXPECT_EQ(forest_labels[j], cached_labels[j]);
+			for(int k = 0; k < MONDRIAN_LABEL_COUNT; ++k)
+				EXPECT_EQ(forest_scores[j * MONDRIAN_LABEL_COUNT + k], cached_scores[j * MONDRIAN_LABEL_COUNT + k]);
+		}
+		//Both forests draw the same random numbers
+		srand(i);
+		forest->train(features + i * MONDRIAN_FEATURE_COUNT, labels[i]);
+		srand(i);
+		cached->train(features + i * MONDRIAN_FEATURE_COUNT, labels[i]);
+	}
+	delete forest;
+	delete cached;
+}
+/**
+ * Check that the copy of a node keeps all its fields.
+ */
+template<class node_type>
+void expect_full_copy(void){
+	node_type node;
+	node.split_dimension = 1;
+	node.split_value = 0.5;
+	node.child_left = 2;
+	node.child_right = 3;
+	node.parent = 4;
+	node.tau = 1.5;
+	node.counters[0] += 7;
+	node.bound_lower[0] = -1;
+	node.bound_upper[0] = 1;
+	node.forced_extend = 5;
+	node.fading_score = 2.5;
+	node_type const copied(node);
+	node_type assigned;
+	assigned = node;
+	node_type const* copies[2] = {&copied, &assigned};
+	for(int c = 0; c < 2; ++c){
+		node_type const* copy = copies[c];
+		EXPECT_EQ(1, copy->split_dimension);
+		EXPECT_EQ(0.5, copy->split_value);
+		EXPECT_EQ(2, copy->child_left);
+		EXPECT_EQ(3, copy->child_right);
+		EXPECT_EQ(4, copy->parent);
+		EXPECT_EQ(1.5, copy->tau);
+		EXPECT_EQ(7, copy->counters[0]);
+		EXPECT_EQ(-1, copy->bound_lower[0]);
+		EXPECT_EQ(1, copy->bound_upper[0]);
+		EXPECT_EQ(5, copy->forced_extend);
+		EXPECT_EQ(2.5, copy->fading_score);
+	}
+}
+TEST(MondrianNode, copy) {
+	expect_full_copy<MondrianNode<MONDRIAN_FEATURE_COUNT, MONDRIAN_LABEL_COUNT>>();
+	expect_full_copy<CompactMondrianNode<MONDRIAN_FEATURE_COUNT, MONDRIAN_LABEL_COUNT>>();
+}
+TEST(MondrianNode, compact) {
+	typedef CompactMondrianNode<MONDRIAN_FEATURE_COUNT, MONDRIAN_LABEL_COUNT, uint8_t> Compact;
+	EXPECT_LT(sizeof(Compact), sizeof(MondrianNode<MONDRIAN_FEATURE_COUNT, MONDRIAN_LABEL_COUNT>));
+	int const max_node_count = Compact::MAX_NODE_COUNT;
+	EXPECT_EQ(32767, max_node_count);
+	//The small counters stop at their maximum value
+	Compact node;
+	node.counters[0] += 300;
+	EXPECT_EQ(255, node.counters[0]);
+}
+}
@@ -62,21 +62,193 @@ TEST(NaiveBayes, prediction) {
 	int result = classifier.predict(haha, scores);
 	EXPECT_EQ (0, result);
 }
-//TEST(NaiveBayes, smoothing) { 
-	//int features_size[FEATURE_COUNT_NB] = {3, 3, 2, 2};
-	//NaiveBayes<2,FEATURE_COUNT_NB,functions> classifier(features_size);
-	//for(int i = 0; i < COUNT_ENTRY_NB; ++i)
-		//classifier.train(dt[i], labels[i]);
+/*
+ * Compute the expected scores of a data point from the estimators of each label and feature.
+ */
+void expected_scores(GaussianEstimator<functions> estimators[2][2], double const* label_weights, double const* point, double* scores){
+	for(int l = 0; l < 2; ++l){
+		scores[l] = std::log(label_weights[l] / (label_weights[0] + label_weights[1]));
+		for(int f = 0; f < 2; ++f)
+			scores[l] += std::log(estimators[l][f].probability_density(point[f]));
+	}
+}
+TEST(NaiveBayes, cached_scores) { 
+	/*
+	 * The scores come from cached values that must follow the training.
+	 */
+	NaiveBayes<double, 2, 2, functions> classifier;
+	GaussianEstimator<functions> estimators[2][2] = {};
+	double label_weights[2] = {0};
+	double point[2] = {1.5, -0.5};
+	double scores[2], expected[2];
+	srand(42);
+	for(int i = 0; i < 200; ++i){
+		int const label = rand() % 2;
+		double const features[2] = {label + (rand() % 100) / 50.0, -label + (rand() % 100) / 100.0};
+		classifier.train(features, label);
+		estimators[label][0].train(features[0], 1.0);
+		estimators[label][1].train(features[1], 1.0);
+		label_weights[label] += 1;
+		if(i % 50 == 49){
+			classifier.predict(point, scores);
+			expected_scores(estimators, label_weights, point, expected);
+			EXPECT_NEAR(expected[0], scores[0], 1e-3);
+			EXPECT_NEAR(expected[1], scores[1], 1e-3);
+		}
+	}
+}
+TEST(NaiveBayes, predict_batch) { 
+	NaiveBayes<double, 2,FEATURE_COUNT_NB,functions> classifier;
+	for(int i = 0; i < COUNT_ENTRY_NB; ++i)
+		classifier.train(dt[i], labels[i]);
+	int batch_labels[COUNT_ENTRY_NB];
+	double batch_scores[COUNT_ENTRY_NB][2];
+	classifier.predict_batch(&dt[0][0], COUNT_ENTRY_NB, batch_labels, &batch_scores[0][0]);
+	for(int i = 0; i < COUNT_ENTRY_NB; ++i){
+		double scores[2];
+		EXPECT_EQ(classifier.predict(dt[i], scores), batch_labels[i]);
+		EXPECT_EQ(scores[0], batch_scores[i][0]);
+		EXPECT_EQ(scores[1], batch_scores[i][1]);
+	}
+}
+TEST(NaiveBayes, smoothing) { 
+	int features_size[FEATURE_COUNT_NB] = {3, 3, 2, 2};
+	NaiveBayes<double, 2, FEATURE_COUNT_NB, functions, CategoricalFeatures<3>> classifier(features_size);
+	for(int i = 0; i < COUNT_ENTRY_NB; ++i)
+		classifier.train(dt[i], labels[i]);
 
-	//double scores[2];
-	//int haha[FEATURE_COUNT_NB] = {2, 0, 1, 1};
-	//int result = classifier.predict(haha, scores);
-	//EXPECT_EQ (0, result);
+	double scores[2];
+	double haha[FEATURE_COUNT_NB] = {2, 0, 1, 1};
+	int result = classifier.predict(haha, scores);
+	EXPECT_EQ (0, result);
+	//With a smoothing of 1, P(label 0) = 5/14, P(2|0) = (3+1)/(5+3), P(0|0) = (1+1)/(5+3), P(1|0) = (4+1)/(5+2) and P(1|0) = (3+1)/(5+2)
+	EXPECT_NEAR(std::log(5.0/14 * 4.0/8 * 2.0/8 * 5.0/7 * 4.0/7), scores[0], 1e-9);
 
-	//double smoothing = classifier.get_smoothing();
-	//double scores_sm[2];
-	//classifier.set_smoothing(0.1);
-	//result = classifier.predict(haha, scores_sm);
-	//ASSERT_NE(scores_sm[0], scores[0]);		
-	//ASSERT_NE(scores_sm[1], scores[1]);		
-//}
+	double smoothing = classifier.get_smoothing();
+	EXPECT_EQ(1.0, smoothing);
+	double scores_sm[2];
+	classifier.set_smoothing(0.1);
+	result = classifier.predict(haha, scores_sm);
+	ASSERT_NE(scores_sm[0], scores[0]);		
+	ASSERT_NE(scores_sm[1], scores[1]);		
+}
+TEST(NaiveBayes, multinomial) { 
+	/*
+	 * Each label draws its events from a different distribution over the three features.
+	 */
+	NaiveBayes<int, 2, 3, functions, MultinomialFeatures> classifier;
+	int const events[4][3] = {{5, 1, 0}, {4, 0, 1}, {0, 2, 6}, {1, 1, 5}};
+	int const events_labels[4] = {0, 0, 1, 1};
+	for(int i = 0; i < 4; ++i)
+		classifier.train(events[i], events_labels[i]);
+	double scores[2];
+	int const point[3] = {2, 1, 0};
+	EXPECT_EQ(0, classifier.predict(point, scores));
+	//With a smoothing of 1, the probabilities of the events of label 0 are (9+1)/(11+3), (1+1)/(11+3) and (1+1)/(11+3)
+	EXPECT_NEAR(std::log(0.5) + 2 * std::log(10.0/14) + std::log(2.0/14), scores[0], 1e-9);
+	int const other[3] = {0, 1, 3};
+	EXPECT_EQ(1, classifier.predict(other));
+}
+/*
+ * Policy that models the first two features as categorical and the other ones as Gaussian.
+ */
+class MixedFeatures{
+	public:
+	static int const value_count = 4;
+	static int model(int const feature){
+		return (feature < 2 ? NaiveBayesModel::CATEGORICAL : NaiveBayesModel::GAUSSIAN);
+	}
+};
+TEST(NaiveBayes, mixed_features) { 
+	/*
+	 * The label depends on a categorical code and on a numeric value.
+	 */
+	NaiveBayes<double, 2, 3, functions, MixedFeatures> classifier;
+	srand(42);
+	for(int i = 0; i < 500; ++i){
+		int const label = rand() % 2;
+		double const features[3] = {static_cast<double>(label == 0 ? rand() % 2 : 2 + rand() % 2), static_cast<double>(rand() % 4), label * 5 + (rand() % 100) / 50.0};
+		classifier.train(features, label);
+	}
+	double const first[3] = {1, 2, 1};
+	double const second[3] = {3, 2, 6};
+	EXPECT_EQ(0, classifier.predict(first));
+	EXPECT_EQ(1, classifier.predict(second));
+	//The numeric feature alone is enough when the code is out of the table
+	double const unknown[3] = {7, 2, 6};
+	EXPECT_EQ(1, classifier.predict(unknown));
+}
+TEST(NaiveBayes, fractional_weights) { 
+	/*
+	 * The discrete features keep the fractions of the weights, so two halves of a data point count as the whole data point.
+	 */
+	NaiveBayes<double, 2, 3, functions, MixedFeatures> halves, whole;
+	srand(42);
+	for(int i = 0; i < 200; ++i){
+		int const label = rand() % 2;
+		double const features[3] = {static_cast<double>(rand() % 4), static_cast<double>(label + rand() % 3), label * 3 + (rand() % 100) / 25.0};
+		halves.train(features, label, 0.5);
+		halves.train(features, label, 0.5);
+		whole.train(features, label);
+	}
+	double const point[3] = {1, 2, 2.5};
+	double expected[2], scores[2];
+	whole.predict(point, expected);
+	halves.predict(point, scores);
+	EXPECT_NEAR(expected[0], scores[0], 1e-9);
+	EXPECT_NEAR(expected[1], scores[1], 1e-9);
+}
+TEST(NaiveBayes, merge) { 
+	/*
+	 * Two classifiers trained on two halves of the data points, then merged, should give the scores of a classifier trained on all of them.
+	 */
+	NaiveBayes<double, 2, 3, functions, MixedFeatures> all, first, second;
+	srand(42);
+	for(int i = 0; i < 400; ++i){
+		int const label = rand() % 2;
+		double const features[3] = {static_cast<double>(rand() % 4), static_cast<double>(label + rand() % 3), label * 3 + (rand() % 100) / 25.0};
+		all.train(features, label);
+		(i < 150 ? first : second).train(features, label);
+	}
+	EXPECT_TRUE(first.merge(second));
+	double const point[3] = {1, 2, 2.5};
+	double expected[2], scores[2];
+	all.predict(point, expected);
+	first.predict(point, scores);
+	EXPECT_NEAR(expected[0], scores[0], 1e-9);
+	EXPECT_NEAR(expected[1], scores[1], 1e-9);
+	//A classifier with other numbers of values per feature is rejected
+	int const features_size[3] = {2, 4, 4};
+	NaiveBayes<double, 2, 3, functions, MixedFeatures> other(features_size);
+	other.train(point, 0);
+	EXPECT_FALSE(first.merge(other));
+	first.predict(point, scores);
+	EXPECT_NEAR(expected[0], scores[0], 1e-9);
+	EXPECT_NEAR(expected[1], scores[1], 1e-9);
+}
+TEST(NaiveBayes, save_load) { 
+	NaiveBayes<double, 2, 3, functions, MixedFeatures> classifier, loaded;
+	srand(42);
+	for(int i = 0; i < 100; ++i){
+		int const label = rand() % 2;
+		double const features[3] = {static_cast<double>(rand() % 4), static_cast<double>(label + rand() % 3), label * 3 + (rand() % 100) / 25.0};
+		classifier.train(features, label);
+	}
+	char buffer[1024];
+	int const size = classifier.get_save_size();
+	//4 integers of header, 3 sizes, the smoothing, the total and 2 label weights, 2 Gaussian estimators and 2 times 4 double counts for each categorical feature
+	EXPECT_EQ(7 * 4 + 4 * 8 + 2 * 24 + 2 * 2 * 4 * 8, size);
+	EXPECT_EQ(-1, classifier.save(buffer, size - 1));
+	EXPECT_EQ(size, classifier.save(buffer, sizeof(buffer)));
+	EXPECT_FALSE(loaded.load(buffer, size - 1));
+	EXPECT_TRUE(loaded.load(buffer, size));
+	double const point[3] = {1, 2, 2.5};
+	double expected[2], scores[2];
+	classifier.predict(point, expected);
+	loaded.predict(point, scores);
+	EXPECT_EQ(expected[0], scores[0]);
+	EXPECT_EQ(expected[1], scores[1]);
+	//A buffer from another type of classifier is rejected
+	NaiveBayes<double, 3, 3, functions, MixedFeatures> other;
+	EXPECT_FALSE(other.load(buffer, size));
+}
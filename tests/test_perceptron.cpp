@@ -1,5 +1,6 @@
 #include <cstdlib>
 #include <cmath>
+#include <limits>
 #include <iostream>
 using namespace std;
 #include "gtest/gtest.h"
@@ -59,5 +60,202 @@ TEST(MultilayerPerceptron, backpropagate) {
 
 	EXPECT_NEAR(output[0], expected[0], 0.0001);
 }
+TEST(MultilayerPerceptron, blocked_layers) {
+	//Layers of 6 and 3 neurons over 5 and 6 inputs use both the blocks of four rows and the remaining rows and columns
+	int layer_size[3] = {5, 6, 3};
+	double weights[6*6 + 3*7];
+	for(int i = 0; i < 6*6 + 3*7; ++i)
+		weights[i] = ((i * 7) % 11 - 5) * 0.1;
+	double input[5] = {1.5, -2, 0.5, 3, -1}, output[3] = {0};
+	MultiLayerPerceptron<3, 60000, functions> mlp(layer_size);
+	mlp.set_weights(weights);
+	mlp.feed_forward(input, output);
+
+	double hidden[6], expected[3];
+	for(int n = 0; n < 6; ++n){
+		hidden[n] = weights[n*6 + 5];
+		for(int i = 0; i < 5; ++i)
+			hidden[n] += weights[n*6 + i] * input[i];
+	}
+	for(int n = 0; n < 3; ++n){
+		expected[n] = weights[36 + n*7 + 6];
+		for(int i = 0; i < 6; ++i)
+			expected[n] += weights[36 + n*7 + i] * hidden[i];
+	}
+	for(int n = 0; n < 3; ++n)
+		EXPECT_NEAR(output[n], expected[n], 0.0001);
+}
+TEST(MultilayerPerceptron, blocked_layers_rounding) {
+	//The partial sums of the kernels change the order of the additions, so the outputs match a sequential dot product up to its rounding error
+	int layer_size[3] = {64, 32, 8};
+	int const weight_count = 32*65 + 8*33;
+	double weights[weight_count];
+	srand(42);
+	for(int i = 0; i < weight_count; ++i)
+		weights[i] = 2 * functions::random() - 1;
+	double input[64], output[8];
+	for(int i = 0; i < 64; ++i)
+		input[i] = 2 * functions::random() - 1;
+	MultiLayerPerceptron<3, 60000, functions> mlp(layer_size);
+	mlp.set_weights(weights);
+	mlp.feed_forward(input, output);
+
+	//A sum of n terms computed in any order is within (n-1)*u*sum(|terms|) of the exact sum, so two orders are within (n-1)*epsilon*sum(|terms|)
+	double const epsilon = std::numeric_limits<double>::epsilon();
+	double hidden[32], hidden_error[32];
+	for(int n = 0; n < 32; ++n){
+		hidden[n] = weights[n*65 + 64];
+		double magnitude = std::fabs(hidden[n]);
+		for(int i = 0; i < 64; ++i){
+			hidden[n] += weights[n*65 + i] * input[i];
+			magnitude += std::fabs(weights[n*65 + i] * input[i]);
+		}
+		hidden_error[n] = 64 * epsilon * magnitude;
+	}
+	for(int n = 0; n < 8; ++n){
+		double const* row = weights + 32*65 + n*33;
+		double expected = row[32], magnitude = std::fabs(row[32]), propagated_error = 0;
+		for(int i = 0; i < 32; ++i){
+			expected += row[i] * hidden[i];
+			magnitude += std::fabs(row[i] * hidden[i]);
+			propagated_error += std::fabs(row[i]) * hidden_error[i];
+		}
+		EXPECT_NEAR(expected, output[n], 32 * epsilon * magnitude + propagated_error);
+	}
+}
+TEST(MultilayerPerceptron, feed_forward_batch) {
+	int layer_size[3] = {5, 6, 3};
+	double weights[6*6 + 3*7];
+	for(int i = 0; i < 6*6 + 3*7; ++i)
+		weights[i] = ((i * 7) % 11 - 5) * 0.1;
+	double input[7*5], output[7*3], expected[3];
+	for(int i = 0; i < 7*5; ++i)
+		input[i] = ((i * 3) % 7 - 3) * 0.5;
+	MultiLayerPerceptron<3, 60000, functions> mlp(layer_size);
+	mlp.set_weights(weights);
+	mlp.feed_forward_batch(input, output, 7);
+
+	for(int i = 0; i < 7; ++i){
+		mlp.feed_forward(input + i*5, expected);
+		for(int n = 0; n < 3; ++n)
+			EXPECT_NEAR(output[i*3 + n], expected[n], 0.0001);
+	}
+}
+TEST(MultilayerPerceptron, train_batch) {
+	//A mini-batch of identical data points has the same gradient as one data point
+	int layer_size[3] = {2, 2, 1};
+	double initial_weights[9] = {1,1,1,1,1,1,1,1,1};
+	double weights[6] = {0.5, 0.5, 0.1, 0.25, 0.25, 0.1};
+	double input[2] = {1.5, 3}, output[1] = {0}, expected[1] = {2.849713370};
+	double inputs[10] = {1.5, 3, 1.5, 3, 1.5, 3, 1.5, 3, 1.5, 3}, real_outputs[5] = {4, 4, 4, 4, 4};
+	MultiLayerPerceptron<3, 60000, functions> mlp(layer_size);
+	mlp.set_weights(initial_weights);
+	mlp.set_weights(1, 0, weights);
+	mlp.set_weights(1, 1, weights+3);
+	mlp.train_batch(inputs, real_outputs, 5);
+	mlp.feed_forward(input, output);
+
+	EXPECT_NEAR(output[0], expected[0], 0.0001);
+}
+TEST(StaticMultiLayerPerceptron, same_as_dynamic) {
+	int layer_size[3] = {5, 6, 3};
+	double weights[6*6 + 3*7];
+	for(int i = 0; i < 6*6 + 3*7; ++i)
+		weights[i] = ((i * 7) % 11 - 5) * 0.1;
+	double input[5] = {1.5, -2, 0.5, 3, -1}, real_output[3] = {1, 0, -1};
+	double output[3] = {0}, static_output[3] = {0};
+	MultiLayerPerceptron<3, 60000, functions> mlp(layer_size);
+	typedef StaticMultiLayerPerceptron<functions, SGD<functions>, 5, 6, 3> StaticMLP;
+	StaticMLP static_mlp;
+	mlp.set_weights(weights);
+	static_mlp.set_weights(weights);
+
+	EXPECT_EQ(StaticMLP::get_weight_count(), 6*6 + 3*7);
+	EXPECT_EQ(sizeof(static_mlp), sizeof(double) * (1 + 6*6 + 3*7 + 5 + 6 + 3));
+	for(int step = 0; step < 3; ++step){
+		mlp.feed_forward(input, output);
+		static_mlp.feed_forward(input, static_output);
+		for(int n = 0; n < 3; ++n)
+			EXPECT_NEAR(static_output[n], output[n], 0.0000001);
+		EXPECT_NEAR(static_mlp.backpropagate(real_output), mlp.backpropagate(real_output), 0.0000001);
+	}
+	for(int i = 0; i < 6*6 + 3*7; ++i)
+		EXPECT_NEAR(static_mlp.get_weights()[i], mlp.get_weights()[i], 0.0000001);
+}
+class bounded_functions{
+	public:
+	static double activation(double const input){
+		return input / (1 + std::fabs(input));
+	}
+	static double derivative(double const output){
+		double const d = 1 - std::fabs(output);
+		return d * d;
+	}
+	static double random(void){
+		return (static_cast<double>(std::rand()) / static_cast<double>(RAND_MAX)) - 0.5;
+	}
+	static double sqrt(double const x){
+		return std::sqrt(x);
+	}
+};
+template<class optimizer>
+double train_with_optimizer(optimizer const& adjuster, double const learning_rate, double const* inputs, double const* expected){
+	int layer_size[3] = {8, 16, 4};
+	std::srand(7);
+	MultiLayerPerceptron<3, 60000, bounded_functions, optimizer> mlp(layer_size, learning_rate);
+	mlp.set_optimizer(adjuster);
+	double output[4], error = 0;
+	for(int epoch = 0; epoch < 20; ++epoch){
+		error = 0;
+		for(int i = 0; i < 64; ++i){
+			mlp.feed_forward(inputs + i*8, output);
+			error += mlp.backpropagate(expected + i*4);
+		}
+	}
+	return error / 64;
+}
+TEST(MultilayerPerceptron, optimizers) {
+	double inputs[64*8], expected[64*4];
+	std::srand(3);
+	for(int i = 0; i < 64*8; ++i)
+		inputs[i] = (std::rand() % 200 - 100) / 50.0;
+	for(int i = 0; i < 64; ++i)
+		for(int n = 0; n < 4; ++n)
+			expected[i*4 + n] = (inputs[i*8 + n] > inputs[i*8 + n + 4] ? 0.5 : -0.5);
+
+	double const sgd = train_with_optimizer(SGD<bounded_functions>(), 0.01, inputs, expected);
+	//Without momentum, the momentum optimizer is the plain gradient descent
+	EXPECT_DOUBLE_EQ(train_with_optimizer(Momentum<bounded_functions>(0), 0.01, inputs, expected), sgd);
+	EXPECT_LT(train_with_optimizer(Momentum<bounded_functions>(0.9), 0.01, inputs, expected), sgd);
+	EXPECT_LT(train_with_optimizer(RMSProp<bounded_functions>(), 0.001, inputs, expected), sgd);
+	EXPECT_LT(train_with_optimizer(Adam<bounded_functions>(), 0.01, inputs, expected), sgd);
+}
+TEST(StaticMultiLayerPerceptron, optimizer) {
+	/*
+	 * With the same optimizer, the static network should adjust its weights like the dynamic one.
+	 */
+	int layer_size[3] = {5, 6, 3};
+	double weights[6*6 + 3*7];
+	for(int i = 0; i < 6*6 + 3*7; ++i)
+		weights[i] = ((i * 7) % 11 - 5) * 0.1;
+	double input[5] = {1.5, -2, 0.5, 3, -1}, real_output[3] = {0.5, 0, -0.5};
+	double output[3] = {0}, static_output[3] = {0};
+	typedef Adam<bounded_functions> optimizer;
+	MultiLayerPerceptron<3, 60000, bounded_functions, optimizer> mlp(layer_size, 0.01);
+	StaticMultiLayerPerceptron<bounded_functions, optimizer, 5, 6, 3> static_mlp(0.01);
+	mlp.set_optimizer(optimizer(0.8));
+	static_mlp.set_optimizer(optimizer(0.8));
+	mlp.set_weights(weights);
+	static_mlp.set_weights(weights);
+	for(int step = 0; step < 5; ++step){
+		mlp.feed_forward(input, output);
+		static_mlp.feed_forward(input, static_output);
+		for(int n = 0; n < 3; ++n)
+			EXPECT_NEAR(static_output[n], output[n], 0.0000001);
+		EXPECT_NEAR(static_mlp.backpropagate(real_output), mlp.backpropagate(real_output), 0.0000001);
+	}
+	for(int i = 0; i < 6*6 + 3*7; ++i)
+		EXPECT_NEAR(static_mlp.get_weights()[i], mlp.get_weights()[i], 0.0000001);
+}
 }
 
@@ -0,0 +1,69 @@
+#include <cstdlib>
+#include <cmath>
+#include "gtest/gtest.h"
+#include "quantized_perceptron.hpp"
+
+namespace QuantizedPerceptronTest{
+class functions{
+	public:
+	static double activation(double const input){
+		return input / (1 + std::fabs(input));
+	}
+	static double derivative(double const output){
+		double const d = 1 - std::fabs(output);
+		return d * d;
+	}
+	static double random(void){
+		return (static_cast<double>(std::rand()) / static_cast<double>(RAND_MAX)) - 0.5;
+	}
+};
+
+TEST(QuantizedPerceptron, close_to_network) {
+	int layer_size[3] = {8, 16, 4};
+	std::srand(7);
+	MultiLayerPerceptron<3, 60000, functions> mlp(layer_size);
+	double inputs[64*8], expected[64*4];
+	for(int i = 0; i < 64*8; ++i)
+		inputs[i] = (std::rand() % 200 - 100) / 50.0;
+	for(int i = 0; i < 64; ++i)
+		for(int n = 0; n < 4; ++n)
+			expected[i*4 + n] = (inputs[i*8 + n] > inputs[i*8 + n + 4] ? 0.5 : -0.5);
+	for(int epoch = 0; epoch < 50; ++epoch)
+		mlp.train_batch(inputs, expected, 64);
+
+	QuantizedPerceptron<3, 1024> quantized;
+	ASSERT_TRUE(quantized.quantize(mlp, inputs, 64));
+	//The biases take 4 bytes each, the weights and the outputs 1 byte each, and the two lookup tables 256 bytes each
+	EXPECT_EQ(quantized.get_used_size(), 4 * (16 + 4) + (8*16 + 16*4) + (8 + 16 + 4) + 2 * 256);
+
+	double output[4], quantized_output[4];
+	for(int i = 0; i < 64; ++i){
+		mlp.feed_forward(inputs + i*8, output);
+		quantized.feed_forward(inputs + i*8, quantized_output);
+		for(int n = 0; n < 4; ++n)
+			EXPECT_NEAR(quantized_output[n], output[n], 0.05);
+	}
+}
+TEST(QuantizedPerceptron, too_small) {
+	int layer_size[3] = {8, 16, 4};
+	double input[8] = {0};
+	MultiLayerPerceptron<3, 60000, functions> mlp(layer_size);
+	QuantizedPerceptron<3, 200> quantized;
+	EXPECT_FALSE(quantized.quantize(mlp, input, 1));
+	//The weights, the biases and the outputs fit, but not the lookup tables
+	QuantizedPerceptron<3, 811> without_tables;
+	EXPECT_FALSE(without_tables.quantize(mlp, input, 1));
+	QuantizedPerceptron<3, 812> large_enough;
+	EXPECT_FALSE(large_enough.quantize(mlp, input, 0));
+	EXPECT_TRUE(large_enough.quantize(mlp, input, 1));
+}
+TEST(QuantizedPerceptron, not_quantized) {
+	//Before a successful quantization, feed_forward leaves the output untouched
+	QuantizedPerceptron<3, 1024> quantized;
+	double input[8] = {1, 2, 3, 4, 5, 6, 7, 8}, output[4] = {-1, -1, -1, -1};
+	quantized.feed_forward(input, output);
+	for(int n = 0; n < 4; ++n)
+		EXPECT_EQ(-1, output[n]);
+	EXPECT_EQ(0, quantized.get_used_size());
+}
+}
@@ -67,3 +67,26 @@ TEST(Utils, rand_exponential) {
 	ASSERT_NEAR(mean, expected, 0.01);
 }
 
+TEST(Utils, xorshift_random) { 
+	XorShiftRandom generator(42), same(42), other(43);
+	double sum = 0;
+	bool all_same = true, all_other = true;
+	int const total_count = 48000;
+	for(int i = 0; i < total_count; ++i){
+		double const u = generator.rand_uniform();
+		EXPECT_TRUE(u >= 0 && u < 1);
+		all_same = all_same && (u == same.rand_uniform());
+		all_other = all_other && (u == other.rand_uniform());
+		sum += u;
+	}
+	//The same seed gives the same sequence, another seed gives another sequence
+	EXPECT_TRUE(all_same);
+	EXPECT_FALSE(all_other);
+	ASSERT_NEAR(sum / static_cast<double>(total_count), 0.5, 0.01);
+
+	//The generator can replace the random function
+	double exponential_sum = 0;
+	for(int i = 0; i < total_count; ++i)
+		exponential_sum += Utils::rand_exponential<functions>(27, generator);
+	ASSERT_NEAR(exponential_sum / static_cast<double>(total_count), 1.0/27.0, 0.01);
+}